@@ -0,0 +1,138 @@
+#include "AdaptiveStepper.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+
+const float kInfinity = std::numeric_limits<float>::infinity();
+
+// largest stable dt of symplectic Euler on x'' = -w2*x - c*x'
+float oscillatorLimit(float w2, float c)
+{
+    if (!(w2 > 0.0f)) return c > 0.0f ? 2.0f / c : kInfinity;
+    return (std::sqrt(c*c + 4.0f*w2) - c) / w2;
+}
+
+bool isExplicit(Particle::UpdateMethod method)
+{
+    return method == Particle::UpdateMethod::EulerOrig || method == Particle::UpdateMethod::EulerSemi ||
+           method == Particle::UpdateMethod::Verlet;
+}
+
+}  // namespace
+
+
+float StepLimits::smallest() const
+{
+    return std::min(stability, std::min(courant, error));
+}
+
+
+AdaptiveStepper::AdaptiveStepper() :
+m_tolerance(1e-3f), m_courant(0.5f), m_maxSubsteps(64), m_boundsVersion(-1), m_boundsCoefficients(-1), m_boundsParticles(0),
+m_maxStiffness(0.0f), m_maxDamping(0.0f), m_maxStiffnessPerMass(0.0f), m_maxDampingPerMass(0.0f)
+{
+}
+
+void AdaptiveStepper::setTolerance(float tolerance)
+{
+    m_tolerance = tolerance;
+}
+
+float AdaptiveStepper::getTolerance() const
+{
+    return m_tolerance;
+}
+
+void AdaptiveStepper::setCourantNumber(float courant)
+{
+    m_courant = courant;
+}
+
+float AdaptiveStepper::getCourantNumber() const
+{
+    return m_courant;
+}
+
+void AdaptiveStepper::setMaxSubsteps(int maxSubsteps)
+{
+    m_maxSubsteps = std::max(1, maxSubsteps);
+}
+
+int AdaptiveStepper::getMaxSubsteps() const
+{
+    return m_maxSubsteps;
+}
+
+void AdaptiveStepper::updateSpringBounds(const SpringNetwork& springs, const ParticleStore& particles, int numParticles)
+{
+    const std::vector<int>& adjStart = springs.getAdjacencyStart();
+    const std::vector<int>& adjSpring = springs.getAdjacentSprings();
+
+    m_maxStiffness = m_maxDamping = m_maxStiffnessPerMass = m_maxDampingPerMass = 0.0f;
+    for (int i = 0; i + 1 < (int) adjStart.size() && i < numParticles; i++)
+    {
+        float k = 0.0f, c = 0.0f;
+        for (int e = adjStart[i]; e < adjStart[i + 1]; e++)
+        {
+            k += springs.stiffness[adjSpring[e]];
+            c += springs.damping[adjSpring[e]];
+        }
+        m_maxStiffness = std::max(m_maxStiffness, k);
+        m_maxDamping   = std::max(m_maxDamping, c);
+        m_maxStiffnessPerMass = std::max(m_maxStiffnessPerMass, k*particles.invMass[i]);
+        m_maxDampingPerMass   = std::max(m_maxDampingPerMass, c*particles.invMass[i]);
+    }
+
+    m_boundsVersion = springs.getTopologyVersion();
+    m_boundsCoefficients = springs.getCoefficientVersion();
+    m_boundsParticles = numParticles;
+}
+
+StepLimits AdaptiveStepper::estimate(const SpringNetwork& springs, const ParticleStore& particles, int numParticles,
+                                     float forceScale, float lengthScale, Particle::UpdateMethod method)
+{
+    const bool verlet = method == Particle::UpdateMethod::Verlet;
+    StepLimits limits = { kInfinity, kInfinity, kInfinity };
+
+    if (isExplicit(method))
+    {
+        if (m_boundsVersion != springs.getTopologyVersion() || m_boundsCoefficients != springs.getCoefficientVersion() ||
+            m_boundsParticles != numParticles)
+            updateSpringBounds(springs, particles, numParticles);
+
+        // Gershgorin: the eigenvalues of the spring Jacobian are at most
+        // twice the largest per-particle sum
+        float w2 = 2.0f*forceScale*(verlet ? m_maxStiffnessPerMass : m_maxStiffness);
+        float c  = 2.0f*forceScale*(verlet ? m_maxDampingPerMass : m_maxDamping);
+        limits.stability = m_courant*oscillatorLimit(w2, c);
+    }
+
+    // fastest particle and largest acceleration (the forces of the last step)
+    float maxSpeed2 = 0.0f, maxAccel2 = 0.0f;
+    for (int i = 0; i < numParticles; i++)
+    {
+        if (!particles.active[i] || particles.fixed[i]) continue;
+        glm::vec3 v = particles.velocity.get(i);
+        glm::vec3 a = particles.force.get(i)*(verlet ? particles.invMass[i] : 1.0f);
+        maxSpeed2 = std::max(maxSpeed2, glm::dot(v, v));
+        maxAccel2 = std::max(maxAccel2, glm::dot(a, a));
+    }
+
+    if (maxSpeed2 > 0.0f && lengthScale > 0.0f)
+        limits.courant = m_courant*lengthScale / std::sqrt(maxSpeed2);
+    if (isExplicit(method) && maxAccel2 > 0.0f && m_tolerance > 0.0f)
+        limits.error = std::sqrt(2.0f*m_tolerance / std::sqrt(maxAccel2));
+
+    return limits;
+}
+
+int AdaptiveStepper::chooseSubsteps(const StepLimits& limits, float frameDt) const
+{
+    float dt = limits.smallest();
+    if (!(dt > 0.0f) || !(frameDt > 0.0f)) return 1;
+    float substeps = std::ceil(frameDt / dt);
+    return substeps < (float) m_maxSubsteps ? std::max(1, (int) substeps) : m_maxSubsteps;
+}
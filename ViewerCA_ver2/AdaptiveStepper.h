@@ -0,0 +1,70 @@
+#pragma once
+#include "Particle.h"
+#include "ParticleStore.h"
+#include "SpringNetwork.h"
+
+// Largest substep each criterion allows; a criterion that does not apply is
+// +infinity.
+struct StepLimits
+{
+    float stability; // explicit methods: stiffest spring neighborhood over mass
+    float courant;   // fastest particle against the smallest collider / grid cell
+    float error;     // explicit methods: 1/2*|a|*dt^2 <= tolerance
+
+    float smallest() const;
+};
+
+// Splits a frame into as many equal substeps as the current state needs.
+//
+// The explicit methods (EulerOrig, EulerSemi, Verlet) are only stable while
+// dt <= (sqrt(c^2 + 4w^2) - c) / w^2 for the stiffest spring mode (w^2, c
+// the spring stiffness and damping over mass); both are bounded per particle
+// by twice the sum over its springs (Gershgorin), cached per topology and
+// coefficient version of the network. Every method also keeps the fastest particle from moving
+// more than a fraction of the smallest collider or neighbor cell per substep,
+// so it cannot tunnel. Implicit and XPBD are unconditionally stable and only
+// get the latter.
+//
+// The courant number scales the stability and tunneling limits (< 1 leaves a
+// margin); the tolerance bounds the displacement the acceleration adds in one
+// explicit substep. A calm scene takes one substep per frame.
+class AdaptiveStepper
+{
+public:
+    AdaptiveStepper();
+
+    // world units, default 1e-3
+    void setTolerance(float tolerance);
+    float getTolerance() const;
+    // default 0.5
+    void setCourantNumber(float courant);
+    float getCourantNumber() const;
+    // cap on the substeps of one frame, default 64
+    void setMaxSubsteps(int maxSubsteps);
+    int getMaxSubsteps() const;
+
+    // particles.velocity must be current; forceScale is the factor the spring
+    // forces are applied with, lengthScale the smallest collider/cell size
+    StepLimits estimate(const SpringNetwork& springs, const ParticleStore& particles, int numParticles,
+                        float forceScale, float lengthScale, Particle::UpdateMethod method);
+
+    // ceil(frameDt / limits.smallest()), clamped to [1, getMaxSubsteps()]
+    int chooseSubsteps(const StepLimits& limits, float frameDt) const;
+
+private:
+    void updateSpringBounds(const SpringNetwork& springs, const ParticleStore& particles, int numParticles);
+
+    float m_tolerance;
+    float m_courant;
+    int   m_maxSubsteps;
+
+    // max over the particles of the summed stiffness / damping of their
+    // springs, as is and times 1/mass (Verlet)
+    int   m_boundsVersion; // topology version they were computed for, -1 if none
+    int   m_boundsCoefficients; // and coefficient version
+    int   m_boundsParticles;
+    float m_maxStiffness;
+    float m_maxDamping;
+    float m_maxStiffnessPerMass;
+    float m_maxDampingPerMass;
+};
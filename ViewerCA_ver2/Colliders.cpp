@@ -0,0 +1,295 @@
+#include "Colliders.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "triangle_mesh.h"
+
+
+const float ColliderSet::kSkin = 1e-4f;
+
+namespace {
+
+// more crossings than this in one step (a particle caught in a concave
+// corner) stop the mesh response
+const int kMaxMeshBounces = 4;
+
+// Same response as Particle::correctCollisionParticlePlane
+void reflect(const Plane& p, float bouncing, glm::vec3& pos, glm::vec3& vel)
+{
+    pos = pos - (1 + bouncing)*(glm::dot(pos, p.normal) + p.d)*p.normal;
+    vel = vel - (1 + bouncing)*(glm::dot(vel, p.normal) /*+ p.d*/)*p.normal;
+}
+
+// reflection about the plane through point with unit normal n, ending at
+// least kSkin on the side of n; only a velocity towards the plane reflects
+void bounce(const glm::vec3& point, const glm::vec3& n, float bouncing, glm::vec3& pos, glm::vec3& vel)
+{
+    pos -= (1 + bouncing)*glm::dot(pos - point, n)*n;
+    float gap = glm::dot(pos - point, n);
+    if (gap < ColliderSet::kSkin) pos += (ColliderSet::kSkin - gap)*n;
+    float vn = glm::dot(vel, n);
+    if (vn < 0.0f) vel -= (1 + bouncing)*vn*n;
+}
+
+// distance (world units) and unit outward normal of the field at p; false
+// outside its grid or where the gradient vanishes
+bool sampleSdf(const SdfCollider& sdf, const glm::vec3& p, float* distance, glm::vec3* normal)
+{
+    glm::vec3 gradient;
+    if (!sdf.field->sample((p - sdf.translation) / sdf.scale, distance, &gradient)) return false;
+    float length = glm::length(gradient);
+    if (!(length > 0.0f)) return false;
+    *distance *= sdf.scale;
+    *normal = gradient / length;
+    return true;
+}
+
+bool insideSdf(const SdfCollider& sdf, const glm::vec3& p)
+{
+    float distance;
+    return sdf.field->sample((p - sdf.translation) / sdf.scale, &distance, nullptr) && distance < 0.0f;
+}
+
+// distNow <= r^2 as in Particle::collisionParticleSphere (sic: squared radius)
+bool crossesSphere(const Sphere& sph, glm::vec3 prev, glm::vec3 cur, float* distNow)
+{
+    float distPrev = sqrt( pow((prev.x - sph.center.x), 2) + pow((prev.y - sph.center.y), 2) + pow((prev.z - sph.center.z), 2) );
+    *distNow       = sqrt( pow((cur.x  - sph.center.x), 2) + pow((cur.y  - sph.center.y), 2) + pow((cur.z  - sph.center.z), 2) );
+    return *distNow <= (sph.radius * sph.radius) && distPrev > (sph.radius * sph.radius);
+}
+
+bool outsideBox(const Box& box, const glm::vec3& p)
+{
+    return p.x < box.min.x || p.x > box.max.x || p.y < box.min.y || p.y > box.max.y ||
+           p.z < box.min.z || p.z > box.max.z;
+}
+
+// whether the segment a -> b goes from outside the box into it; axis is the
+// one of the face it enters through
+bool entersBox(const Box& box, const glm::vec3& a, const glm::vec3& b, int* axis)
+{
+    if (!outsideBox(box, a)) return false;
+
+    const glm::vec3 d = b - a;
+    float tEnter = 0.0f, tExit = 1.0f;
+    *axis = -1;
+    for (int k = 0; k < 3; k++)
+    {
+        if (d[k] == 0.0f)
+        {
+            if (a[k] < box.min[k] || a[k] > box.max[k]) return false;
+            continue;
+        }
+        float t0 = (box.min[k] - a[k]) / d[k];
+        float t1 = (box.max[k] - a[k]) / d[k];
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > tEnter) { tEnter = t0; *axis = k; }
+        tExit = std::min(tExit, t1);
+        if (tEnter > tExit) return false;
+    }
+    return *axis >= 0;
+}
+
+// point on the face of the box normal to axis that faces direction
+// -sign(along), and its outward normal
+void boxFace(const Box& box, int axis, float along, glm::vec3* point, glm::vec3* normal)
+{
+    *point = box.min;
+    *normal = glm::vec3(0.0f);
+    if (along > 0.0f)
+    {
+        (*normal)[axis] = -1.0f;
+    }
+    else
+    {
+        (*point)[axis] = box.max[axis];
+        (*normal)[axis] = 1.0f;
+    }
+}
+
+}  // namespace
+
+
+ColliderSet::ColliderSet()
+{
+}
+
+void ColliderSet::clear()
+{
+    planes.clear();
+    spheres.clear();
+    boxes.clear();
+    meshes.clear();
+    sdfs.clear();
+}
+
+void ColliderSet::addMesh(const data_representation::TriangleMesh& mesh, float scale, const glm::vec3& translation)
+{
+    std::vector<glm::vec3> vertices(mesh.vertices_.size() / 3);
+    for (size_t k = 0; k < vertices.size(); k++)
+        vertices[k] = glm::vec3(mesh.vertices_[3*k], mesh.vertices_[3*k + 1], mesh.vertices_[3*k + 2])*scale + translation;
+
+    meshes.emplace_back();
+    meshes.back().build(vertices, mesh.faces_);
+}
+
+void ColliderSet::addSdf(std::shared_ptr<const SignedDistanceField> field, float scale, const glm::vec3& translation)
+{
+    sdfs.push_back({ field, scale, translation });
+}
+
+bool ColliderSet::crosses(const glm::vec3& prev, const glm::vec3& cur) const
+{
+    for (const Plane& p : planes)
+    {
+        float sign = ( glm::dot(cur, p.normal) + p.d ) * ( glm::dot(prev, p.normal) + p.d );
+        if ( sign <= 0.0f ) return true;
+    }
+
+    float distNow;
+    for (const Sphere& sph : spheres)
+        if (crossesSphere(sph, prev, cur, &distNow)) return true;
+
+    int axis;
+    for (const Box& box : boxes)
+        if (entersBox(box, prev, cur, &axis)) return true;
+
+    for (const TriangleBvh& mesh : meshes)
+        if (mesh.intersectsAny(prev, cur)) return true;
+
+    for (const SdfCollider& sdf : sdfs)
+        if (insideSdf(sdf, cur)) return true;
+
+    return false;
+}
+
+void ColliderSet::collide(const glm::vec3& prev, glm::vec3& pos, glm::vec3& vel, float bouncing) const
+{
+    for (const Plane& p : planes)
+    {
+        float sign = glm::dot(pos, p.normal) + p.d;
+        sign      *= glm::dot(prev, p.normal) + p.d;
+        if ( sign <= 0.0f ) reflect(p, bouncing, pos, vel);
+    }
+
+    for (const Sphere& sph : spheres)
+    {
+        float distNow;
+        if ( !crossesSphere( sph, prev, pos, &distNow ) ) continue;
+        //https://math.stackexchange.com/questions/831109/closest-point-on-a-sphere-to-another-point
+        glm::vec3 q = sph.center + sph.radius*( prev - sph.center ) / distNow;
+        Plane tanPlaneToSphere(
+                 q.x, q.y, q.z,   //P
+                 q.x - sph.center[0],    // N.x
+                 q.y - sph.center[1],    // N.y
+                 q.z - sph.center[2] );  // N.z
+        reflect( tanPlaneToSphere, -0.9f, pos, vel ); // no bouncing
+    }
+
+    for (const Box& box : boxes)
+    {
+        int axis;
+        if (!entersBox(box, prev, pos, &axis)) continue;
+        glm::vec3 point, n;
+        boxFace(box, axis, pos[axis] - prev[axis], &point, &n);
+        bounce(point, n, bouncing, pos, vel);
+    }
+
+    // after a bounce the rest of the step may cross the mesh again
+    for (const TriangleBvh& mesh : meshes)
+    {
+        glm::vec3 from = prev;
+        TriangleBvh::Hit hit;
+        for (int k = 0; k < kMaxMeshBounces && mesh.intersect(from, pos, &hit); k++)
+        {
+            bounce(hit.point, hit.normal, bouncing, pos, vel);
+            from = hit.point + kSkin*hit.normal;
+        }
+    }
+
+    // the surface point is distance along -normal (the field is only
+    // linear within a cell, so the reflection may land a little inside)
+    for (const SdfCollider& sdf : sdfs)
+    {
+        float distance;
+        glm::vec3 n;
+        if (!sampleSdf(sdf, pos, &distance, &n) || distance >= 0.0f) continue;
+        bounce(pos - distance*n, n, bouncing, pos, vel);
+    }
+}
+
+void ColliderSet::project(glm::vec3& x, glm::vec3& q) const
+{
+    for (const Plane& p : planes)
+    {
+        float C = glm::dot(x, p.normal) + p.d;
+        if (C >= 0.0f) continue;
+        x -= C * p.normal;
+        if (glm::dot(q, p.normal) + p.d < 0.0f) q -= C * p.normal;
+    }
+
+    for (const Sphere& sph : spheres)
+    {
+        glm::vec3 d = x - sph.center;
+        float dist = glm::length(d);
+        if (!(dist < sph.radius && dist > 0.0f)) continue;
+        glm::vec3 push = d * (sph.radius / dist - 1.0f);
+        x += push;
+        if (glm::length(q - sph.center) < sph.radius) q += push;
+    }
+
+    // out through the face the step entered by, or the nearest one for a
+    // particle that was already inside
+    for (const Box& box : boxes)
+    {
+        if (outsideBox(box, x)) continue;
+        int axis = 0;
+        float along = 1.0f;
+        if (entersBox(box, q, x, &axis))
+        {
+            along = x[axis] - q[axis];
+        }
+        else
+        {
+            glm::vec3 toMin = x - box.min, toMax = box.max - x;
+            float best = std::numeric_limits<float>::infinity();
+            for (int k = 0; k < 3; k++)
+            {
+                if (toMin[k] < best) { best = toMin[k]; axis = k; along = 1.0f; }
+                if (toMax[k] < best) { best = toMax[k]; axis = k; along = -1.0f; }
+            }
+        }
+        glm::vec3 point, n;
+        boxFace(box, axis, along, &point, &n);
+        glm::vec3 push = (kSkin - glm::dot(x - point, n))*n;
+        x += push;
+        if (!outsideBox(box, q)) q += push;
+    }
+
+    for (const TriangleBvh& mesh : meshes)
+    {
+        TriangleBvh::Hit hit;
+        if (mesh.intersect(q, x, &hit))
+            x += (kSkin - glm::dot(x - hit.point, hit.normal))*hit.normal;
+    }
+
+    for (const SdfCollider& sdf : sdfs)
+    {
+        float distance;
+        glm::vec3 n;
+        if (!sampleSdf(sdf, x, &distance, &n) || distance >= 0.0f) continue;
+        glm::vec3 push = (kSkin - distance)*n;
+        x += push;
+        if (insideSdf(sdf, q)) q += push;
+    }
+}
+
+float ColliderSet::getSmallestSize() const
+{
+    float size = std::numeric_limits<float>::infinity();
+    for (const Sphere& sph : spheres)
+        size = std::min(size, sph.radius);
+    for (const SdfCollider& sdf : sdfs)
+        size = std::min(size, sdf.field->getCellSize()*sdf.scale);
+    return size;
+}
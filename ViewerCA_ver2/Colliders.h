@@ -0,0 +1,83 @@
+#pragma once
+#ifdef WIN32
+	#include <glm\glm.hpp>
+#else
+	#include <glm/glm.hpp>
+#endif
+#include <memory>
+#include <vector>
+#include "Plane.h"
+#include "SignedDistanceField.h"
+#include "Sphere.h"
+#include "TriangleBvh.h"
+
+namespace data_representation {
+class TriangleMesh;
+}  // namespace data_representation
+
+// Solid axis-aligned box; particles bounce off its outside.
+struct Box
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// A baked mesh placed in the scene: world = field coordinates*scale + translation.
+// Fields are shared, so several placements of one model cost one bake.
+struct SdfCollider
+{
+    std::shared_ptr<const SignedDistanceField> field;
+    float     scale;
+    glm::vec3 translation;
+};
+
+// Everything the particles collide with, by kind (one array each, like
+// SpringNetwork): planes, spheres, boxes, triangle meshes, each mesh with a
+// TriangleBvh over its triangles, and signed distance fields.
+//
+// The tests are between the segment a particle swept during the step, from
+// its previous to its current position, and each collider, in the order
+// planes, spheres, boxes, meshes, fields; a hit reflects the position and
+// velocity about the surface with the particle's bouncing. Planes, boxes and
+// meshes are tested continuously, so a fast particle cannot pass through
+// them. A field only looks at the current position: one trilinear sample,
+// and the gradient as the normal, for a particle that ends the step inside
+// (a mesh costs O(log T) per particle, a field O(1) but one bake).
+// Planes and spheres keep the tests of Particle::collisionParticlePlane /
+// collisionParticleSphere: a plane reflects a particle that reaches or
+// touches it, and a sphere catches particles within radius^2 of its center
+// (sic) and slides them along the tangent plane.
+class ColliderSet
+{
+public:
+    ColliderSet();
+
+    void clear();
+
+    // mesh.vertices_*scale + translation, in world space
+    void addMesh(const data_representation::TriangleMesh& mesh, float scale, const glm::vec3& translation);
+    void addSdf(std::shared_ptr<const SignedDistanceField> field, float scale, const glm::vec3& translation);
+
+    // true if collide() would change a particle moving from prev to cur
+    bool crosses(const glm::vec3& prev, const glm::vec3& cur) const;
+    // response of a particle that moved from prev to pos this step
+    void collide(const glm::vec3& prev, glm::vec3& pos, glm::vec3& vel, float bouncing) const;
+    // XPBD: moves x out of the colliders it entered since q, the start of
+    // the step; q goes along when it was inside too, so the push adds no
+    // velocity
+    void project(glm::vec3& x, glm::vec3& q) const;
+
+    // smallest sphere radius or field cell, what a fast particle can skip
+    // through in one step; +infinity without spheres and fields
+    float getSmallestSize() const;
+
+    std::vector<Plane>       planes;
+    std::vector<Sphere>      spheres;
+    std::vector<Box>         boxes;
+    std::vector<TriangleBvh> meshes;
+    std::vector<SdfCollider> sdfs;
+
+    // gap kept between a particle and a box, mesh or field surface it was pushed
+    // back to, so that the next step starts strictly on the outside
+    static const float kSkin;
+};
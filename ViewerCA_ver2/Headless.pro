@@ -0,0 +1,76 @@
+# Headless batch driver: the particle solver without Qt or OpenGL.
+
+QT       -= core gui
+
+TARGET = ParticlesHeadless
+TEMPLATE = app
+
+CONFIG += c++14 console thread
+CONFIG -= app_bundle qt
+CONFIG(release, release|debug):QMAKE_CXXFLAGS += -Wall -O2
+
+CONFIG(release, release|debug):DESTDIR = release/
+CONFIG(release, release|debug):OBJECTS_DIR = release/headless/
+
+CONFIG(debug, release|debug):DESTDIR = debug/
+CONFIG(debug, release|debug):OBJECTS_DIR = debug/headless/
+
+# per-phase step timers (StepProfiler.h): debug builds, or qmake CONFIG+=profile
+CONFIG(debug, release|debug)|profile:DEFINES += PARTICLES_PROFILE
+
+INCLUDEPATH += /usr/include/eigen3/
+
+SOURCES += \
+    headless_main.cpp \
+    TrajectoryWriter.cpp \
+    PlyFrameWriter.cpp \
+    Sphere.cpp \
+    Plane.cpp \
+    ParticleSystem.cpp \
+    ParticleStore.cpp \
+    ParticleKernels.cpp \
+    ThreadPool.cpp \
+    SpatialGrid.cpp \
+    SpringNetwork.cpp \
+    ImplicitSolver.cpp \
+    XpbdSolver.cpp \
+    AdaptiveStepper.cpp \
+    TriangleBvh.cpp \
+    Colliders.cpp \
+    SignedDistanceField.cpp \
+    ParticleEmitter.cpp \
+    ParticlePool.cpp \
+    RandomStream.cpp \
+    StepProfiler.cpp \
+    triangle_mesh.cc \
+    mesh_io.cc \
+    mapped_file.cc \
+    mesh_cache.cc \
+    Particle.cpp
+
+HEADERS  += \
+    TrajectoryWriter.h \
+    PlyFrameWriter.h \
+    Sphere.h \
+    Plane.h \
+    ParticleSystem.h \
+    ParticleStore.h \
+    ParticleKernels.h \
+    ThreadPool.h \
+    SpatialGrid.h \
+    SpringNetwork.h \
+    ImplicitSolver.h \
+    XpbdSolver.h \
+    AdaptiveStepper.h \
+    TriangleBvh.h \
+    Colliders.h \
+    SignedDistanceField.h \
+    ParticleEmitter.h \
+    ParticlePool.h \
+    RandomStream.h \
+    StepProfiler.h \
+    triangle_mesh.h \
+    mesh_io.h \
+    mapped_file.h \
+    mesh_cache.h \
+    Particle.h
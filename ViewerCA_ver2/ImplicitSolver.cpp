@@ -0,0 +1,167 @@
+#include "ImplicitSolver.h"
+#include <algorithm>
+#include <cmath>
+
+
+ImplicitSpringSolver::ImplicitSpringSolver() : m_numSprings(0), m_topologyVersion(-1)
+{
+    m_cg.setTolerance(1e-5f);
+    m_cg.setMaxIterations(100);
+}
+
+void ImplicitSpringSolver::setTolerance(float tolerance)
+{
+    m_cg.setTolerance(tolerance);
+}
+
+void ImplicitSpringSolver::setMaxIterations(int maxIterations)
+{
+    m_cg.setMaxIterations(maxIterations);
+}
+
+int ImplicitSpringSolver::getIterations() const
+{
+    return (int) m_cg.iterations();
+}
+
+float ImplicitSpringSolver::getError() const
+{
+    return m_cg.error();
+}
+
+void ImplicitSpringSolver::buildPattern(const SpringNetwork& springs, int numParticles)
+{
+    const std::vector<int>& adjStart = springs.getAdjacencyStart();
+    const std::vector<int>& adjSpring = springs.getAdjacentSprings();
+    m_numSprings = springs.getNumSprings();
+    m_topologyVersion = springs.getTopologyVersion();
+
+    // neighbors of each particle (itself included), sorted
+    std::vector<int> nbrStart(numParticles + 1, 0);
+    std::vector<int> nbr;
+    nbr.reserve((size_t) numParticles + adjSpring.size());
+    for (int i = 0; i < numParticles; i++)
+    {
+        nbr.push_back(i);
+        for (int k = adjStart[i]; k < adjStart[i + 1]; k++)
+        {
+            int s = adjSpring[k];
+            nbr.push_back(springs.a[s] == i ? springs.b[s] : springs.a[s]);
+        }
+        std::vector<int>::iterator first = nbr.begin() + nbrStart[i];
+        std::sort(first, nbr.end());
+        nbr.erase(std::unique(first, nbr.end()), nbr.end());
+        nbrStart[i + 1] = (int) nbr.size();
+    }
+
+    auto rank = [&](int i, int j) {
+        return (int) (std::lower_bound(nbr.begin() + nbrStart[j], nbr.begin() + nbrStart[j + 1], i) - nbr.begin()) - nbrStart[j];
+    };
+    m_rankSelf.resize(numParticles);
+    for (int i = 0; i < numParticles; i++)
+        m_rankSelf[i] = rank(i, i);
+    m_rankA.resize(m_numSprings);
+    m_rankB.resize(m_numSprings);
+    for (int s = 0; s < m_numSprings; s++)
+    {
+        m_rankA[s] = rank(springs.a[s], springs.b[s]);
+        m_rankB[s] = rank(springs.b[s], springs.a[s]);
+    }
+
+    // compressed column storage written directly: column 3i+c holds rows
+    // 3j, 3j+1, 3j+2 for every neighbor j of i
+    const int n = 3 * numParticles;
+    m_A.resize(n, n);
+    m_A.resizeNonZeros(9 * (int) nbr.size());
+    int* outer = m_A.outerIndexPtr();
+    int* inner = m_A.innerIndexPtr();
+    int k = 0;
+    for (int i = 0; i < numParticles; i++)
+        for (int c = 0; c < 3; c++)
+        {
+            outer[3 * i + c] = k;
+            for (int e = nbrStart[i]; e < nbrStart[i + 1]; e++)
+                for (int r = 0; r < 3; r++)
+                    inner[k++] = 3 * nbr[e] + r;
+        }
+    outer[n] = k;
+
+    m_dv.setZero(n);
+}
+
+void ImplicitSpringSolver::addBlock(int column, int k, const glm::mat3& block, float sign)
+{
+    for (int c = 0; c < 3; c++)
+    {
+        float* values = m_A.valuePtr() + m_A.outerIndexPtr()[3 * column + c] + 3 * k;
+        for (int r = 0; r < 3; r++)
+            values[r] += sign * block[c][r];
+    }
+}
+
+void ImplicitSpringSolver::solve(const SpringNetwork& springs, float springScale, ParticleStore& particles,
+                                 int numParticles, float dt)
+{
+    const int n = 3 * numParticles;
+    if (m_A.rows() != n || m_topologyVersion != springs.getTopologyVersion())
+        buildPattern(springs, numParticles);
+
+    const std::vector<std::uint8_t>& fixed = particles.fixed;
+
+    m_b.resize(n);
+    for (int i = 0; i < numParticles; i++)
+    {
+        glm::vec3 f = fixed[i] ? glm::vec3(0.0f) : dt * particles.force.get(i);
+        m_b.segment<3>(3 * i) << f.x, f.y, f.z;
+    }
+
+    std::fill(m_A.valuePtr(), m_A.valuePtr() + m_A.nonZeros(), 0.0f);
+    for (int i = 0; i < numParticles; i++)
+        addBlock(i, m_rankSelf[i], glm::mat3(1.0f), 1.0f);
+
+    for (int s = 0; s < m_numSprings; s++)
+    {
+        const int a = springs.a[s], b = springs.b[s];
+        if (fixed[a] && fixed[b]) continue;
+
+        glm::vec3 d = particles.position.get(a) - particles.position.get(b);
+        float dist = glm::length(d);
+        if (!(dist > 0.0f)) continue;
+
+        // -df_a/dx_a = k*(n n^T + alpha*(I - n n^T)), alpha clamped at 0 when compressed;
+        // -df_a/dv_a = c*n n^T
+        glm::vec3 u = d / dist;
+        glm::mat3 nnT = glm::outerProduct(u, u);
+        float alpha = std::max(0.0f, 1.0f - springs.restLength[s] / dist);
+        glm::mat3 K = springScale * springs.stiffness[s] * ((1.0f - alpha) * nnT + alpha * glm::mat3(1.0f));
+        glm::mat3 P = (dt * dt) * K + (dt * springScale * springs.damping[s]) * nnT;
+
+        // dt^2*df/dx*v
+        glm::vec3 Kv = -(dt * dt) * (K * (particles.velocity.get(a) - particles.velocity.get(b)));
+
+        if (!fixed[a])
+        {
+            addBlock(a, m_rankSelf[a], P, 1.0f);
+            m_b.segment<3>(3 * a) += Eigen::Vector3f(Kv.x, Kv.y, Kv.z);
+        }
+        if (!fixed[b])
+        {
+            addBlock(b, m_rankSelf[b], P, 1.0f);
+            m_b.segment<3>(3 * b) -= Eigen::Vector3f(Kv.x, Kv.y, Kv.z);
+        }
+        if (!fixed[a] && !fixed[b])
+        {
+            addBlock(b, m_rankA[s], P, -1.0f); // row a, column b
+            addBlock(a, m_rankB[s], P, -1.0f); // row b, column a
+        }
+    }
+
+    m_cg.compute(m_A);
+    m_dv = m_cg.solveWithGuess(m_b, m_dv);
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        if (fixed[i]) continue;
+        particles.force.set(i, glm::vec3(m_dv[3 * i], m_dv[3 * i + 1], m_dv[3 * i + 2]) / dt);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <Eigen/IterativeLinearSolvers>
+#include <Eigen/SparseCore>
+#include <vector>
+#include "ParticleStore.h"
+#include "SpringNetwork.h"
+
+// Backward Euler for a SpringNetwork (Baraff & Witkin, "Large steps in cloth
+// simulation"). The spring forces are linearized around the current state,
+//
+//     (I - dt*df/dv - dt^2*df/dx) dv = dt*(f + dt*df/dx*v),
+//
+// and the sparse system is solved with Jacobi-preconditioned conjugate
+// gradients, warm-started from the previous step's dv. As with the explicit
+// Euler methods, force is an acceleration (mass is not applied). The elastic
+// Jacobian of a compressed spring is clamped so the system stays symmetric
+// positive definite, which costs some accuracy but never stability.
+//
+// The sparsity pattern (one 3x3 block per particle and per spring end) is
+// built by buildPattern() on the first solve of each topology version of the
+// network; each step only rewrites the values in place. Fixed particles keep their velocity: their rows and
+// columns hold the identity and their right-hand side is zero.
+class ImplicitSpringSolver
+{
+public:
+    ImplicitSpringSolver();
+
+    // CG stops at this relative residual or after maxIterations
+    void setTolerance(float tolerance);
+    void setMaxIterations(int maxIterations);
+
+    // solve() calls it when the topology changes (SpringNetwork::getTopologyVersion)
+    void buildPattern(const SpringNetwork& springs, int numParticles);
+
+    // Replaces force[i] of every free particle by dv_i/dt, so that the
+    // EulerSemi update (v += force*dt; x += v*dt) completes the implicit
+    // step. force must already hold gravity plus springScale times the
+    // spring forces; the spring Jacobians are scaled the same way.
+    void solve(const SpringNetwork& springs, float springScale, ParticleStore& particles, int numParticles, float dt);
+
+    // of the last solve
+    int getIterations() const;
+    float getError() const;
+
+private:
+    typedef Eigen::SparseMatrix<float> Matrix;
+
+    // adds sign*block to the 3x3 block of A at (row particle, column particle),
+    // stored at rank k among the column particle's neighbors
+    void addBlock(int column, int k, const glm::mat3& block, float sign);
+
+    // the 3 columns of particle i share the same rows: its neighbors, sorted,
+    // 3 rows each. m_rankSelf[i] is the rank of i among them, m_rankA[s] the
+    // rank of a[s] among the neighbors of b[s], m_rankB[s] the converse.
+    std::vector<int> m_rankSelf;
+    std::vector<int> m_rankA;
+    std::vector<int> m_rankB;
+    int m_numSprings;
+    int m_topologyVersion; // of the network the pattern was built for
+
+    Matrix m_A;
+    Eigen::VectorXf m_b;
+    Eigen::VectorXf m_dv;
+    Eigen::ConjugateGradient<Matrix, Eigen::Lower | Eigen::Upper> m_cg;
+};
@@ -5,27 +5,17 @@
 //}
 
 
-float fRando(float fMin, float fMax)
-{
-    float f = (float)rand() / RAND_MAX;
-    return fMin + f * (fMax - fMin);
-}
-
-
-
 Particle::Particle() :
-m_currentPosition(0,0,0), m_previousPosition(0, 0, 0), m_velocity(0, 0, 0), m_force(0, 0, 0), m_bouncing(0), m_life(0), /*m_lifetime(50),*/ m_fixed(false), m_mass(1.0)
+m_currentPosition(0,0,0), m_previousPosition(0, 0, 0), m_velocity(0, 0, 0), m_force(0, 0, 0), m_bouncing(0), m_lifetime(kDefaultLifetime), m_life(0), m_fixed(false), m_mass(1.0)
 {
-    m_lifetime = fRando(10, 20);
 }
 
 Particle::Particle(const float& x, const float& y, const float& z) :
-m_previousPosition(0, 0, 0), m_velocity(0, 0, 0), m_force(0, 0, 0), m_bouncing(0), /*m_lifetime(50),*/ m_fixed(false), m_mass(1.0)
+m_previousPosition(0, 0, 0), m_velocity(0, 0, 0), m_force(0, 0, 0), m_bouncing(0), m_lifetime(kDefaultLifetime), m_life(0), m_fixed(false), m_mass(1.0)
 {
 	m_currentPosition.x = x;
 	m_currentPosition.y = y;
 	m_currentPosition.z = z;
-    m_lifetime = fRando(10, 20);
 }
 
 /*
@@ -188,6 +178,8 @@ void Particle::updateParticle(const float& dt, UpdateMethod method)
             }
                 break;
             case UpdateMethod::EulerSemi:
+            case UpdateMethod::Implicit: // no springs on a lone particle: backward Euler is EulerSemi
+            case UpdateMethod::XPBD:     // and XPBD has nothing to project
             {
                 m_previousPosition = m_currentPosition;
                 m_velocity += m_force*dt;
@@ -306,6 +298,7 @@ bool Particle::collisionParticleTriangle(glm::vec3 p1, glm::vec3 p2, glm::vec3 p
         glm::vec3 vc1 = glm::cross(p1-p2, p2-p3);
         return glm::abs(glm::dot( (p1-m_currentPosition), vc1 )) >= 0.01;
     }
+    return false; // outside the prism of the triangle
 }
 
 
@@ -7,10 +7,14 @@
 #include "Plane.h"
 #include "Sphere.h"
 
+// Seconds a lone particle lives; ParticleSystem draws the lifetimes of its
+// particles in [10, 20) from its seed.
+const float kDefaultLifetime = 15.0f;
+
 class Particle
 {
 public:
-	enum class UpdateMethod : std::int8_t { EulerOrig, EulerSemi, Verlet };
+	enum class UpdateMethod : std::int8_t { EulerOrig, EulerSemi, Verlet, Implicit, XPBD };
 
 	Particle();
 	Particle(const float& x, const float& y, const float& z);
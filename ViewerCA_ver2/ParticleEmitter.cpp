@@ -0,0 +1,136 @@
+#include "ParticleEmitter.h"
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+const float kPi = 3.14159265358979f;
+
+// unit vectors u, v completing the unit vector n to an orthonormal basis
+void basis(const glm::vec3& n, glm::vec3* u, glm::vec3* v)
+{
+    glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    *u = glm::normalize(glm::cross(n, axis));
+    *v = glm::cross(n, *u);
+}
+
+// in [-1, 1)^3; one statement per draw, so that the order is fixed
+glm::vec3 symmetric(RandomStream& random)
+{
+    float x = random.uniform(-1.0f, 1.0f);
+    float y = random.uniform(-1.0f, 1.0f);
+    float z = random.uniform(-1.0f, 1.0f);
+    return glm::vec3(x, y, z);
+}
+
+}  // namespace
+
+
+EmitterSettings EmitterSettings::fountain()
+{
+    EmitterSettings s;
+    s.rate        = 100.0f;
+    s.shape       = EmitterShape::Disc;
+    s.center      = glm::vec3(0.0f, -5.9f, -3.5f);
+    s.size        = glm::vec3(0.2f);
+    s.velocity    = glm::vec3(0.0f, 3.5f, 0.0f);
+    s.spreadAngle = 0.3f;
+    s.speedJitter = 0.1f;
+    s.lifetimeMin = 4.0f;
+    s.lifetimeMax = 6.0f;
+    s.mass        = 0.1f;
+    s.bouncing    = 0.6f;
+    return s;
+}
+
+EmitterSettings EmitterSettings::waterfall()
+{
+    EmitterSettings s;
+    s.rate        = 200.0f;
+    s.shape       = EmitterShape::Box;
+    s.center      = glm::vec3(-5.5f, 4.0f, 0.0f);
+    s.size        = glm::vec3(0.1f, 0.1f, 2.0f);
+    s.velocity    = glm::vec3(1.3f, 0.0f, 0.0f);
+    s.spreadAngle = 0.05f;
+    s.speedJitter = 0.05f;
+    s.lifetimeMin = 8.0f;
+    s.lifetimeMax = 10.0f;
+    s.mass        = 0.1f;
+    s.bouncing    = 0.3f;
+    return s;
+}
+
+
+ParticleEmitter::ParticleEmitter(const EmitterSettings& settings) : m_settings(settings), m_carry(0.0f)
+{
+}
+
+EmitterSettings& ParticleEmitter::getSettings()
+{
+    return m_settings;
+}
+
+const EmitterSettings& ParticleEmitter::getSettings() const
+{
+    return m_settings;
+}
+
+void ParticleEmitter::restart(std::uint64_t seed, std::uint64_t stream)
+{
+    m_carry = 0.0f;
+    m_random = RandomStream(seed, stream);
+}
+
+int ParticleEmitter::take(float dt)
+{
+    m_carry += std::max(0.0f, m_settings.rate) * dt;
+    int count = (int) m_carry;
+    m_carry -= (float) count;
+    return count;
+}
+
+void ParticleEmitter::sample(glm::vec3* position, glm::vec3* velocity, float* lifetime)
+{
+    const EmitterSettings& s = m_settings;
+
+    glm::vec3 offset(0.0f);
+    switch (s.shape)
+    {
+    case EmitterShape::Sphere:
+        // rejection from the cube: 52% accepted
+        do offset = symmetric(m_random);
+        while (glm::dot(offset, offset) > 1.0f);
+        offset *= s.size.x;
+        break;
+    case EmitterShape::Box:
+        offset = s.size * symmetric(m_random);
+        break;
+    case EmitterShape::Disc:
+    {
+        float r = s.size.x * std::sqrt(m_random.uniform(0.0f, 1.0f));
+        float phi = m_random.uniform(0.0f, 2.0f*kPi);
+        offset = glm::vec3(r*std::cos(phi), 0.0f, r*std::sin(phi));
+        break;
+    }
+    default:
+        break;
+    }
+    *position = s.center + offset;
+
+    // cos(theta) uniform in [cos(spread), 1] is uniform over the spherical cap
+    float speed = glm::length(s.velocity);
+    *velocity = glm::vec3(0.0f);
+    if (speed > 0.0f)
+    {
+        glm::vec3 n = s.velocity / speed, u, v;
+        basis(n, &u, &v);
+        float cosTheta = m_random.uniform(std::cos(std::min(s.spreadAngle, kPi)), 1.0f);
+        float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta*cosTheta));
+        float phi = m_random.uniform(0.0f, 2.0f*kPi);
+        glm::vec3 direction = cosTheta*n + sinTheta*(std::cos(phi)*u + std::sin(phi)*v);
+        *velocity = speed * (1.0f + s.speedJitter*m_random.uniform(-1.0f, 1.0f)) * direction;
+    }
+
+    *lifetime = m_random.uniform(s.lifetimeMin, std::max(s.lifetimeMin, s.lifetimeMax));
+}
@@ -0,0 +1,58 @@
+#pragma once
+#ifdef WIN32
+	#include <glm\glm.hpp>
+#else
+	#include <glm/glm.hpp>
+#endif
+#include <cstdint>
+#include "RandomStream.h"
+
+// Where an emitter puts its particles: a point, a ball of radius size.x, a
+// box of half extents size, or a horizontal disc of radius size.x.
+enum class EmitterShape : std::int8_t { Point, Sphere, Box, Disc };
+
+struct EmitterSettings
+{
+    float rate;             // particles per second
+    EmitterShape shape;
+    glm::vec3 center;
+    glm::vec3 size;
+    glm::vec3 velocity;     // mean velocity
+    float spreadAngle;      // radians: directions uniform over the cone around velocity
+    float speedJitter;      // speeds uniform in |velocity|*(1 -+ speedJitter)
+    float lifetimeMin;      // seconds, uniform in [lifetimeMin, lifetimeMax]
+    float lifetimeMax;
+    float mass;
+    float bouncing;
+
+    // a jet up from the floor in front of the sphere, and a sheet falling
+    // from the left wall onto it
+    static EmitterSettings fountain();
+    static EmitterSettings waterfall();
+};
+
+// Source of particles for ParticleSystem: how many are due each step and
+// the position, velocity and lifetime of each, drawn from a RandomStream of
+// its own. The particles themselves live in the system's ParticlePool.
+class ParticleEmitter
+{
+public:
+    explicit ParticleEmitter(const EmitterSettings& settings = EmitterSettings::fountain());
+
+    EmitterSettings& getSettings();
+    const EmitterSettings& getSettings() const;
+
+    // particles due after dt more seconds; the fraction of a particle
+    // carries over to the next call, so a rate below 1/dt still emits
+    int take(float dt);
+
+    void sample(glm::vec3* position, glm::vec3* velocity, float* lifetime);
+
+    // back to the first particle of stream of seed, no fraction carried
+    void restart(std::uint64_t seed, std::uint64_t stream);
+
+private:
+    EmitterSettings m_settings;
+    float m_carry;
+    RandomStream m_random;
+};
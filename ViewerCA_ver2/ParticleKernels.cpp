@@ -0,0 +1,298 @@
+#include "ParticleKernels.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <immintrin.h>
+	#define PARTICLE_KERNELS_SSE2 1
+#endif
+
+#if defined(PARTICLE_KERNELS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+	#define PARTICLE_KERNELS_AVX2 1
+	#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+
+IntegrationArrays::IntegrationArrays(ParticleStore& store) :
+px(store.position.x.data()), py(store.position.y.data()), pz(store.position.z.data()),
+qx(store.previousPosition.x.data()), qy(store.previousPosition.y.data()), qz(store.previousPosition.z.data()),
+vx(store.velocity.x.data()), vy(store.velocity.y.data()), vz(store.velocity.z.data()),
+fx(store.force.x.data()), fy(store.force.y.data()), fz(store.force.z.data()),
+invMass(store.invMass.data()), damping(store.damping.data()), active(store.active.data()), fixed(store.fixed.data())
+{
+}
+
+
+namespace {
+
+/* ******** SCALAR ******** */
+
+void eulerOrigScalar(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    for (int i = begin; i < end; i++)
+    {
+        if (!a.active[i] || a.fixed[i]) continue;
+        a.qx[i] = a.px[i];  a.qy[i] = a.py[i];  a.qz[i] = a.pz[i];
+        a.px[i] += a.vx[i]*dt;  a.py[i] += a.vy[i]*dt;  a.pz[i] += a.vz[i]*dt;
+        a.vx[i] += a.fx[i]*dt;  a.vy[i] += a.fy[i]*dt;  a.vz[i] += a.fz[i]*dt;
+    }
+}
+
+void eulerSemiScalar(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    for (int i = begin; i < end; i++)
+    {
+        if (!a.active[i] || a.fixed[i]) continue;
+        a.qx[i] = a.px[i];  a.qy[i] = a.py[i];  a.qz[i] = a.pz[i];
+        a.vx[i] += a.fx[i]*dt;  a.vy[i] += a.fy[i]*dt;  a.vz[i] += a.fz[i]*dt;
+        a.px[i] += a.vx[i]*dt;  a.py[i] += a.vy[i]*dt;  a.pz[i] += a.vz[i]*dt;
+    }
+}
+
+// position Verlet: x += (1 - damping)*(x - x_prev) + f/m*dt^2; the velocity
+// is left for whoever needs it to derive from (x - x_prev)/dt
+void verletScalar(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    const float dt2 = dt*dt;
+    for (int i = begin; i < end; i++)
+    {
+        if (!a.active[i] || a.fixed[i]) continue;
+        const float keep = 1.0f - a.damping[i];
+        const float h = a.invMass[i]*dt2;
+        float dx = a.px[i] - a.qx[i], dy = a.py[i] - a.qy[i], dz = a.pz[i] - a.qz[i];
+        a.qx[i] = a.px[i];  a.qy[i] = a.py[i];  a.qz[i] = a.pz[i];
+        a.px[i] += keep*dx + a.fx[i]*h;
+        a.py[i] += keep*dy + a.fy[i]*h;
+        a.pz[i] += keep*dz + a.fz[i]*h;
+    }
+}
+
+
+#ifdef PARTICLE_KERNELS_SSE2
+/* ******** SSE2: 4 particles per instruction ******** */
+
+// lanes set for particles that are active and not fixed
+inline __m128 maskSSE(const IntegrationArrays& a, int i)
+{
+    std::int32_t act, fix;
+    memcpy(&act, a.active + i, 4);
+    memcpy(&fix, a.fixed + i, 4);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i m = _mm_cvtsi32_si128(act & ~fix);
+    m = _mm_unpacklo_epi16(_mm_unpacklo_epi8(m, zero), zero);
+    return _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(m, zero), _mm_set1_epi32(-1)));
+}
+
+inline __m128 selectSSE(__m128 m, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+inline void eulerOrigSSE(float* p, float* q, float* v, const float* f, __m128 m, __m128 dt, int i)
+{
+    __m128 P = _mm_loadu_ps(p + i), V = _mm_loadu_ps(v + i), F = _mm_loadu_ps(f + i);
+    _mm_storeu_ps(q + i, selectSSE(m, P, _mm_loadu_ps(q + i)));
+    _mm_storeu_ps(p + i, selectSSE(m, _mm_add_ps(P, _mm_mul_ps(V, dt)), P));
+    _mm_storeu_ps(v + i, selectSSE(m, _mm_add_ps(V, _mm_mul_ps(F, dt)), V));
+}
+
+inline void eulerSemiSSE(float* p, float* q, float* v, const float* f, __m128 m, __m128 dt, int i)
+{
+    __m128 P = _mm_loadu_ps(p + i), V = _mm_loadu_ps(v + i), F = _mm_loadu_ps(f + i);
+    __m128 Vn = _mm_add_ps(V, _mm_mul_ps(F, dt));
+    _mm_storeu_ps(q + i, selectSSE(m, P, _mm_loadu_ps(q + i)));
+    _mm_storeu_ps(v + i, selectSSE(m, Vn, V));
+    _mm_storeu_ps(p + i, selectSSE(m, _mm_add_ps(P, _mm_mul_ps(Vn, dt)), P));
+}
+
+// K = 1 - damping, H = dt^2/mass
+inline void verletSSE(float* p, float* q, const float* f, __m128 K, __m128 H, __m128 m, int i)
+{
+    __m128 P = _mm_loadu_ps(p + i), Q = _mm_loadu_ps(q + i), F = _mm_loadu_ps(f + i);
+    __m128 dx = _mm_add_ps(_mm_mul_ps(K, _mm_sub_ps(P, Q)), _mm_mul_ps(F, H));
+    _mm_storeu_ps(q + i, selectSSE(m, P, Q));
+    _mm_storeu_ps(p + i, selectSSE(m, _mm_add_ps(P, dx), P));
+}
+
+void eulerOrigKernelSSE(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    const __m128 DT = _mm_set1_ps(dt);
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 m = maskSSE(a, i);
+        eulerOrigSSE(a.px, a.qx, a.vx, a.fx, m, DT, i);
+        eulerOrigSSE(a.py, a.qy, a.vy, a.fy, m, DT, i);
+        eulerOrigSSE(a.pz, a.qz, a.vz, a.fz, m, DT, i);
+    }
+    eulerOrigScalar(a, i, end, dt);
+}
+
+void eulerSemiKernelSSE(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    const __m128 DT = _mm_set1_ps(dt);
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 m = maskSSE(a, i);
+        eulerSemiSSE(a.px, a.qx, a.vx, a.fx, m, DT, i);
+        eulerSemiSSE(a.py, a.qy, a.vy, a.fy, m, DT, i);
+        eulerSemiSSE(a.pz, a.qz, a.vz, a.fz, m, DT, i);
+    }
+    eulerSemiScalar(a, i, end, dt);
+}
+
+void verletKernelSSE(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    const __m128 ONE = _mm_set1_ps(1.0f), DT2 = _mm_set1_ps(dt*dt);
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 m = maskSSE(a, i);
+        __m128 K = _mm_sub_ps(ONE, _mm_loadu_ps(a.damping + i));
+        __m128 H = _mm_mul_ps(_mm_loadu_ps(a.invMass + i), DT2);
+        verletSSE(a.px, a.qx, a.fx, K, H, m, i);
+        verletSSE(a.py, a.qy, a.fy, K, H, m, i);
+        verletSSE(a.pz, a.qz, a.fz, K, H, m, i);
+    }
+    verletScalar(a, i, end, dt);
+}
+#endif // PARTICLE_KERNELS_SSE2
+
+
+#ifdef PARTICLE_KERNELS_AVX2
+/* ******** AVX2: 8 particles per instruction ******** */
+
+AVX2_TARGET inline __m256 maskAVX(const IntegrationArrays& a, int i)
+{
+    __m128i act = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a.active + i));
+    __m128i fix = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a.fixed + i));
+    __m256i m = _mm256_cvtepu8_epi32(_mm_andnot_si128(fix, act));
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(m, _mm256_setzero_si256()));
+}
+
+AVX2_TARGET inline void eulerOrigAVX(float* p, float* q, float* v, const float* f, __m256 m, __m256 dt, int i)
+{
+    __m256 P = _mm256_loadu_ps(p + i), V = _mm256_loadu_ps(v + i), F = _mm256_loadu_ps(f + i);
+    _mm256_storeu_ps(q + i, _mm256_blendv_ps(_mm256_loadu_ps(q + i), P, m));
+    _mm256_storeu_ps(p + i, _mm256_blendv_ps(P, _mm256_add_ps(P, _mm256_mul_ps(V, dt)), m));
+    _mm256_storeu_ps(v + i, _mm256_blendv_ps(V, _mm256_add_ps(V, _mm256_mul_ps(F, dt)), m));
+}
+
+AVX2_TARGET inline void eulerSemiAVX(float* p, float* q, float* v, const float* f, __m256 m, __m256 dt, int i)
+{
+    __m256 P = _mm256_loadu_ps(p + i), V = _mm256_loadu_ps(v + i), F = _mm256_loadu_ps(f + i);
+    __m256 Vn = _mm256_add_ps(V, _mm256_mul_ps(F, dt));
+    _mm256_storeu_ps(q + i, _mm256_blendv_ps(_mm256_loadu_ps(q + i), P, m));
+    _mm256_storeu_ps(v + i, _mm256_blendv_ps(V, Vn, m));
+    _mm256_storeu_ps(p + i, _mm256_blendv_ps(P, _mm256_add_ps(P, _mm256_mul_ps(Vn, dt)), m));
+}
+
+AVX2_TARGET inline void verletAVX(float* p, float* q, const float* f, __m256 K, __m256 H, __m256 m, int i)
+{
+    __m256 P = _mm256_loadu_ps(p + i), Q = _mm256_loadu_ps(q + i), F = _mm256_loadu_ps(f + i);
+    __m256 dx = _mm256_add_ps(_mm256_mul_ps(K, _mm256_sub_ps(P, Q)), _mm256_mul_ps(F, H));
+    _mm256_storeu_ps(q + i, _mm256_blendv_ps(Q, P, m));
+    _mm256_storeu_ps(p + i, _mm256_blendv_ps(P, _mm256_add_ps(P, dx), m));
+}
+
+AVX2_TARGET void eulerOrigKernelAVX(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    const __m256 DT = _mm256_set1_ps(dt);
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 m = maskAVX(a, i);
+        eulerOrigAVX(a.px, a.qx, a.vx, a.fx, m, DT, i);
+        eulerOrigAVX(a.py, a.qy, a.vy, a.fy, m, DT, i);
+        eulerOrigAVX(a.pz, a.qz, a.vz, a.fz, m, DT, i);
+    }
+    eulerOrigScalar(a, i, end, dt);
+}
+
+AVX2_TARGET void eulerSemiKernelAVX(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    const __m256 DT = _mm256_set1_ps(dt);
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 m = maskAVX(a, i);
+        eulerSemiAVX(a.px, a.qx, a.vx, a.fx, m, DT, i);
+        eulerSemiAVX(a.py, a.qy, a.vy, a.fy, m, DT, i);
+        eulerSemiAVX(a.pz, a.qz, a.vz, a.fz, m, DT, i);
+    }
+    eulerSemiScalar(a, i, end, dt);
+}
+
+AVX2_TARGET void verletKernelAVX(const IntegrationArrays& a, int begin, int end, float dt)
+{
+    const __m256 ONE = _mm256_set1_ps(1.0f), DT2 = _mm256_set1_ps(dt*dt);
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 m = maskAVX(a, i);
+        __m256 K = _mm256_sub_ps(ONE, _mm256_loadu_ps(a.damping + i));
+        __m256 H = _mm256_mul_ps(_mm256_loadu_ps(a.invMass + i), DT2);
+        verletAVX(a.px, a.qx, a.fx, K, H, m, i);
+        verletAVX(a.py, a.qy, a.fy, K, H, m, i);
+        verletAVX(a.pz, a.qz, a.fz, K, H, m, i);
+    }
+    verletScalar(a, i, end, dt);
+}
+#endif // PARTICLE_KERNELS_AVX2
+
+}  // namespace
+
+
+KernelIsa detectKernelIsa()
+{
+#if defined(PARTICLE_KERNELS_AVX2)
+    static const KernelIsa isa = __builtin_cpu_supports("avx2") ? KernelIsa::AVX2 : KernelIsa::SSE2;
+    return isa;
+#elif defined(PARTICLE_KERNELS_SSE2)
+    return KernelIsa::SSE2;
+#else
+    return KernelIsa::Scalar;
+#endif
+}
+
+IntegrationKernel selectIntegrationKernel(Particle::UpdateMethod method, KernelIsa isa)
+{
+    switch (isa)
+    {
+#ifdef PARTICLE_KERNELS_AVX2
+        case KernelIsa::AVX2:
+            switch (method)
+            {
+                case Particle::UpdateMethod::EulerOrig: return eulerOrigKernelAVX;
+                case Particle::UpdateMethod::EulerSemi:
+                case Particle::UpdateMethod::Implicit:
+                case Particle::UpdateMethod::XPBD:      return eulerSemiKernelAVX;
+                case Particle::UpdateMethod::Verlet:    return verletKernelAVX;
+            }
+            break;
+#endif
+#ifdef PARTICLE_KERNELS_SSE2
+        case KernelIsa::SSE2:
+            switch (method)
+            {
+                case Particle::UpdateMethod::EulerOrig: return eulerOrigKernelSSE;
+                case Particle::UpdateMethod::EulerSemi:
+                case Particle::UpdateMethod::Implicit:
+                case Particle::UpdateMethod::XPBD:      return eulerSemiKernelSSE;
+                case Particle::UpdateMethod::Verlet:    return verletKernelSSE;
+            }
+            break;
+#endif
+        default:
+            break;
+    }
+
+    switch (method)
+    {
+        case Particle::UpdateMethod::EulerSemi:
+        case Particle::UpdateMethod::Implicit:
+        case Particle::UpdateMethod::XPBD:      return eulerSemiScalar;
+        case Particle::UpdateMethod::Verlet:    return verletScalar;
+        default:                                return eulerOrigScalar;
+    }
+}
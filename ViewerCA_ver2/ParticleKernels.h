@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include "Particle.h"
+#include "ParticleStore.h"
+
+// Batched integration kernels over the SoA arrays of a ParticleStore.
+//
+// Each kernel advances the particles in [begin, end) that have active[i] set
+// and fixed[i] cleared, 4 (SSE2) or 8 (AVX2) particles per instruction, with
+// a scalar loop for the tail. The vector kernels do exactly the same float
+// operations in the same order as the scalar ones, so results are
+// bit-identical unless the compiler contracts the scalar path into FMAs
+// (-ffp-contract with -mfma); in that case they agree to within
+// kIntegrationTolerance * max(1, |value|).
+
+const float kIntegrationTolerance = 1e-6f;
+
+struct IntegrationArrays
+{
+    explicit IntegrationArrays(ParticleStore& store);
+
+    float* px; float* py; float* pz;    // position
+    float* qx; float* qy; float* qz;    // previous position
+    float* vx; float* vy; float* vz;    // velocity (not touched by Verlet)
+    const float* fx; const float* fy; const float* fz;
+    const float* invMass;
+    const float* damping;
+    const std::uint8_t* active;
+    const std::uint8_t* fixed;
+};
+
+typedef void (*IntegrationKernel)(const IntegrationArrays& a, int begin, int end, float dt);
+
+enum class KernelIsa : std::int8_t { Scalar, SSE2, AVX2 };
+
+// Best instruction set available on this CPU (checked once, then cached).
+KernelIsa detectKernelIsa();
+
+// Picks the kernel for a method; call it once per step, not per particle.
+// Implicit gets the EulerSemi kernel: by then the solver has replaced the
+// forces with the implicit accelerations (see ImplicitSolver.h). XPBD uses it
+// as the prediction step, before the constraints are projected (XpbdSolver.h).
+IntegrationKernel selectIntegrationKernel(Particle::UpdateMethod method, KernelIsa isa = detectKernelIsa());
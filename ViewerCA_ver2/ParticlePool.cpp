@@ -0,0 +1,106 @@
+#include "ParticlePool.h"
+#include <algorithm>
+
+
+namespace {
+
+void kill(ParticleStore& store, int i)
+{
+    store.lifetime[i] = 0.0f;
+    store.life[i]     = 0.0f;
+    store.active[i]   = 0;
+    store.fixed[i]    = 0;
+}
+
+}  // namespace
+
+
+ParticlePool::ParticlePool() : m_first(0), m_capacity(0), m_end(0)
+{
+}
+
+void ParticlePool::reset(ParticleStore& store, int first, int capacity)
+{
+    m_first = first;
+    m_capacity = std::max(0, capacity);
+    m_end = first;
+
+    m_free.clear();
+    m_free.reserve(m_capacity);
+    m_alive.assign(m_capacity, 0);
+
+    if (store.size() < first + m_capacity) store.resize(first + m_capacity);
+    for (int i = first; i < first + m_capacity; i++)
+        kill(store, i);
+}
+
+int ParticlePool::allocate()
+{
+    int i;
+    if (!m_free.empty())
+    {
+        i = m_free.back();
+        m_free.pop_back();
+    }
+    else if (m_end < m_first + m_capacity)
+    {
+        i = m_end++;
+    }
+    else
+    {
+        return -1;
+    }
+    m_alive[i - m_first] = 1;
+    return i;
+}
+
+void ParticlePool::release(ParticleStore& store, int i)
+{
+    if (!isAlive(i)) return;
+    m_alive[i - m_first] = 0;
+    m_free.push_back(i);
+    kill(store, i);
+}
+
+void ParticlePool::compact(ParticleStore& store)
+{
+    if (m_free.empty()) return;
+
+    int write = *std::min_element(m_free.begin(), m_free.end());
+    for (int read = write + 1; read < m_end; read++)
+    {
+        if (!m_alive[read - m_first]) continue;
+        store.copyParticle(write, read);
+        m_alive[write - m_first] = 1;
+        m_alive[read - m_first] = 0;
+        kill(store, read);
+        write++;
+    }
+    m_end = write;
+    m_free.clear();
+}
+
+bool ParticlePool::isAlive(int i) const
+{
+    return i >= m_first && i < m_end && m_alive[i - m_first];
+}
+
+int ParticlePool::getFirst() const
+{
+    return m_first;
+}
+
+int ParticlePool::getCapacity() const
+{
+    return m_capacity;
+}
+
+int ParticlePool::getNumAlive() const
+{
+    return m_end - m_first - (int) m_free.size();
+}
+
+int ParticlePool::getEnd() const
+{
+    return m_end;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ParticleStore.h"
+
+// Fixed block of slots [first, first + capacity) of a ParticleStore for
+// particles that come and go (the ones of the emitters).
+//
+// allocate() pops a slot released earlier off a free list, or else takes
+// the next never-used slot at getEnd(); release() pushes a slot on the free
+// list. Both are O(1) and the store and the lists are sized once, by
+// reset(), so spawning and killing never allocate. A kill followed by a
+// spawn reuses the hole in place; compact() closes the holes that are left
+// by moving the live particles after the first one down, in order (stream
+// compaction), so that the live particles are [first, getEnd()) again and a
+// pass over the system never visits a dead one.
+class ParticlePool
+{
+public:
+    ParticlePool();
+
+    // takes over the slots [first, first + capacity) of store, all dead
+    void reset(ParticleStore& store, int first, int capacity);
+
+    // a free slot, -1 if the pool is full
+    int allocate();
+    // slot i dies: it is no longer simulated (lifetime 0, inactive) until allocated again
+    void release(ParticleStore& store, int i);
+    void compact(ParticleStore& store);
+
+    bool isAlive(int i) const;
+    int getFirst() const;
+    int getCapacity() const;
+    int getNumAlive() const;
+    // one past the last slot ever allocated since the last compact()
+    int getEnd() const;
+
+private:
+    int m_first;
+    int m_capacity;
+    int m_end;
+    std::vector<int>          m_free;  // released slots below m_end (a stack)
+    std::vector<std::uint8_t> m_alive; // per slot, from m_first
+};
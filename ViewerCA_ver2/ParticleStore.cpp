@@ -0,0 +1,100 @@
+#include "ParticleStore.h"
+
+
+void Vec3Array::resize(size_t n, glm::vec3 value)
+{
+    x.resize(n, value.x);
+    y.resize(n, value.y);
+    z.resize(n, value.z);
+}
+
+
+
+ParticleStore::ParticleStore() : m_size(0)
+{
+}
+
+ParticleStore::~ParticleStore()
+{
+}
+
+void ParticleStore::resize(int numParticles)
+{
+    int oldSize = m_size;
+    if (numParticles < 0) numParticles = 0;
+
+    position.resize(numParticles);
+    previousPosition.resize(numParticles);
+    velocity.resize(numParticles);
+    force.resize(numParticles);
+
+    mass.resize(numParticles);
+    invMass.resize(numParticles);
+    damping.resize(numParticles, kDefaultDamping);
+    bouncing.resize(numParticles);
+    lifetime.resize(numParticles);
+    life.resize(numParticles);
+    fixed.resize(numParticles);
+    active.resize(numParticles, 1);
+
+    m_size = numParticles;
+
+    // same defaults as std::vector<Particle>::resize used to give us
+    for (int i = oldSize; i < numParticles; i++)
+        setParticle(i, Particle());
+}
+
+int ParticleStore::size() const
+{
+    return m_size;
+}
+
+Particle ParticleStore::getParticle(int i) const
+{
+    Particle p;
+    p.setPosition(position.get(i));
+    p.setPreviousPosition(previousPosition.get(i));
+    p.setVelocity(velocity.get(i));
+    p.setForce(force.get(i));
+    p.setMass(mass[i]);
+    p.setBouncing(bouncing[i]);
+    p.setLifetime(lifetime[i]);
+    p.setLife(life[i]);
+    p.setFixed(fixed[i] != 0);
+    return p;
+}
+
+void ParticleStore::setParticle(int i, Particle p)
+{
+    position.set(i, p.getCurrentPosition());
+    previousPosition.set(i, p.getPreviousPosition());
+    velocity.set(i, p.getVelocity());
+    force.set(i, p.getForce());
+    setMass(i, p.getMass());
+    bouncing[i] = p.getBouncing();
+    lifetime[i] = p.getLifetime();
+    life[i]     = p.getLife();
+    fixed[i]    = p.isFixed() ? 1 : 0;
+}
+
+void ParticleStore::setMass(int i, float m)
+{
+    mass[i]    = m;
+    invMass[i] = 1.0f / m;
+}
+
+void ParticleStore::copyParticle(int dst, int src)
+{
+    position.set(dst, position.get(src));
+    previousPosition.set(dst, previousPosition.get(src));
+    velocity.set(dst, velocity.get(src));
+    force.set(dst, force.get(src));
+    mass[dst]     = mass[src];
+    invMass[dst]  = invMass[src];
+    damping[dst]  = damping[src];
+    bouncing[dst] = bouncing[src];
+    lifetime[dst] = lifetime[src];
+    life[dst]     = life[src];
+    fixed[dst]    = fixed[src];
+    active[dst]   = active[src];
+}
@@ -0,0 +1,71 @@
+#pragma once
+#ifdef WIN32
+	#include <glm\glm.hpp>
+#else
+	#include <glm/glm.hpp>
+#endif
+#include <cstdint>
+#include <vector>
+#include "Particle.h"
+
+// Three contiguous float arrays (x[], y[], z[]) holding one glm::vec3 per particle.
+struct Vec3Array
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    void resize(size_t n, glm::vec3 value = glm::vec3(0.0f));
+
+    glm::vec3 get(int i) const { return glm::vec3(x[i], y[i], z[i]); }
+    void set(int i, glm::vec3 v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+};
+
+// Fraction of the last step's displacement a Verlet particle loses per step
+// (the old hard-coded 0.99 kept the other 99%).
+const float kDefaultDamping = 0.01f;
+
+// Structure-of-arrays particle container used by ParticleSystem.
+// Every attribute of a Particle lives in its own array, so a pass over the
+// system only streams the fields it actually reads (e.g. the spring pass
+// never touches life/lifetime, the life pass never touches positions).
+class ParticleStore
+{
+public:
+    ParticleStore();
+    ~ParticleStore();
+
+    // grows/shrinks every array; new slots get the same defaults as Particle()
+    void resize(int numParticles);
+    int size() const;
+
+    // AoS view of a single particle (copy)
+    Particle getParticle(int i) const;
+    void setParticle(int i, Particle p);
+
+    // sets mass[i] and invMass[i]; use it instead of writing mass directly
+    void setMass(int i, float m);
+
+    // every attribute of particle src into slot dst
+    void copyParticle(int dst, int src);
+
+    Vec3Array position;
+    Vec3Array previousPosition;
+    Vec3Array velocity;
+    Vec3Array force;
+
+    std::vector<float> mass;
+    std::vector<float> invMass; // 1/mass, kept by setMass
+    std::vector<float> damping; // Verlet damping, kDefaultDamping unless set
+    std::vector<float> bouncing;
+    std::vector<float> lifetime;
+    std::vector<float> life;
+    std::vector<std::uint8_t> fixed;
+
+    // per-step scratch: 1 if the particle is simulated this step (not respawning,
+    // not a dead slot of the emitters)
+    std::vector<std::uint8_t> active;
+
+private:
+    int m_size;
+};
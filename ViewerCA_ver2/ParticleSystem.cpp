@@ -1,33 +1,50 @@
 #include "ParticleSystem.h"
-#include <random>
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
 #include <iostream>
+#include "RandomStream.h"
 
-#define rand01() ((float)std::rand()/RAND_MAX)
+// cloth/soft body bending springs, relative to the structural ones
+const float kBendingScale = 0.2f;
 
 
 ParticleSystem::ParticleSystem( )
 {
+    m_seed = 1;
     m_numParticles = 1;
+    m_numSceneParticles = 1;
+    m_emitterCapacity = 0;
+    m_systemType = ParticleSystemType::Fountain;
     float X = 6.0;
     float r = 0.0f; //radius of a particle
 
                     //     Points       Normals
-    floorPlane      = Plane( 0, -X+r, 0,    0, 1, 0 );
+    m_colliders.planes = { Plane( 0, -X+r, 0,    0, 1, 0 ),     // floor
 
-    leftWallPlane   = Plane(  X-r, 0, 0,   -1, 0, 0 );
-    rightWallPlane  = Plane( -X+r, 0, 0,    1, 0, 0 );
+                           Plane(  X-r, 0, 0,   -1, 0, 0 ),     // left wall
+                           Plane( -X+r, 0, 0,    1, 0, 0 ),     // right wall
 
-    frontWallPlane  = Plane( 0, 0, -X+r,    0, 0, 1 );
-    backWallPlane   = Plane( 0, 0,  X-r,    0, 0,-1 );
+                           Plane( 0, 0, -X+r,    0, 0, 1 ),     // front wall
+                           Plane( 0, 0,  X-r,    0, 0,-1 ) };   // back wall
 
                       //     Points         Radius
     float sr = 1.55f;
-    sph             = Sphere(0, -6.0+sr, 0,    sr );
+    m_colliders.spheres = { Sphere(0, -6.0+sr, 0,    sr ) };
 
 
+    m_particleRadius     = 0.1f;
+    m_particleCollisions = false;
+    m_grid.setCellSize( 2.0f*m_particleRadius );
+    m_gridCurrent = false;
+
     k_d  = 13.0f;
     k_e  = -200.0f;
     Long = 0.30f;
+    m_damping  = kDefaultDamping;
+    m_verletDt = 0.0f;
+    m_lastDt   = 0.0f;
 
     // debug
     GF = 0.1f;
@@ -38,39 +55,274 @@ ParticleSystem::~ParticleSystem()
 {
 }
 
+void ParticleSystem::setNumThreads( int numThreads ){
+    if ( numThreads <= 0 )
+        numThreads = std::max( 1, (int) std::thread::hardware_concurrency() );
+
+    if ( numThreads == 1 )
+        m_pool.reset();
+    else if ( !m_pool || m_pool->getNumThreads() != numThreads )
+        m_pool.reset( new ThreadPool( numThreads ) );
+}
+
+void ParticleSystem::setSeed( std::uint64_t seed ){
+    m_seed = seed;
+}
+
+std::uint64_t ParticleSystem::getSeed( ) const {
+    return m_seed;
+}
+
+int ParticleSystem::getNumThreads( ) const {
+    return m_pool ? m_pool->getNumThreads() : 1;
+}
+
+void ParticleSystem::setParticleRadius( float radius ){
+    m_particleRadius = radius;
+    // contacts happen below one diameter, so 27 cells of that size cover them
+    m_grid.setCellSize( 2.0f*radius );
+    m_gridCurrent = false;
+}
+
+float ParticleSystem::getParticleRadius( ) const {
+    return m_particleRadius;
+}
+
+void ParticleSystem::setParticleCollisions( bool enabled ){
+    m_particleCollisions = enabled;
+}
+
+void ParticleSystem::getNeighbors( int i, float radius, std::vector<int>& out ){
+    // the contact pass builds the grid before its corrections move the
+    // particles, and does not run at all without collisions
+    if ( !m_gridCurrent ) {
+        m_grid.build( m_particles.position, m_numParticles, m_particles.active.data() );
+        m_gridCurrent = true;
+    }
+    m_grid.forEachNeighbor( m_particles.position, m_particles.position.get(i), radius,
+                            [&]( int j ) { if ( j != i ) out.push_back( j ); } );
+}
+
 void ParticleSystem::setParticleSystem(int numParticles, ParticleSystemType systemType){
-    m_particleSystem.resize(numParticles);
-    m_numParticles = numParticles;
+    // std::vector keeps its capacity, so going back to a size that was
+    // already used does not reallocate
+    m_particles.resize(numParticles + m_emitterCapacity);
+    m_numSceneParticles = numParticles;
+    m_systemType = systemType;
 
     iniParticleSystem( );
 }
 
 
+SpringCoefficients ParticleSystem::springCoefficients( SpringType type ) const {
+    if ( type == SpringType::Bending ) return { -k_e*kBendingScale, k_d*kBendingScale };
+    return { -k_e, k_d };
+}
+
 void ParticleSystem::setSpringDamping( float val ){
     k_d = val;
+    for (SpringType type : { SpringType::Structural, SpringType::Shear, SpringType::Bending })
+        m_springs.setCoefficients( type, springCoefficients( type ) );
 }
 
 void ParticleSystem::setSpringElasticity( float val ){
     k_e = val;
+    for (SpringType type : { SpringType::Structural, SpringType::Shear, SpringType::Bending })
+        m_springs.setCoefficients( type, springCoefficients( type ) );
 }
 
 void ParticleSystem::setSpringLength( float val ){
     Long = val;
 }
 
+void ParticleSystem::setDamping( float val ){
+    m_damping = val;
+}
+
 
 Particle ParticleSystem::getParticle(int i){
-	return m_particleSystem[i];
+    Particle p = m_particles.getParticle(i);
+    if ( m_verletDt > 0.0f && m_particles.active[i] && !m_particles.fixed[i] )
+        p.setVelocity( (m_particles.position.get(i) - m_particles.previousPosition.get(i)) / m_verletDt );
+    return p;
 }
 
+glm::vec3 ParticleSystem::getPosition( int i ) const {
+    return m_particles.position.get(i);
+}
 
-float fRand(float fMin, float fMax)
-{
-    float f = (float)rand() / RAND_MAX;
-    return fMin + f * (fMax - fMin);
+void ParticleSystem::copyPositions( float* dst ) const {
+    const float* x = m_particles.position.x.data();
+    const float* y = m_particles.position.y.data();
+    const float* z = m_particles.position.z.data();
+    for (int i = 0; i < m_numParticles; i++)
+    {
+        dst[3*i + 0] = x[i];
+        dst[3*i + 1] = y[i];
+        dst[3*i + 2] = z[i];
+    }
+}
+
+void ParticleSystem::copyVelocities( float* dst ) const {
+    const float invDt = m_verletDt > 0.0f ? 1.0f / m_verletDt : 0.0f;
+    for (int i = 0; i < m_numParticles; i++)
+    {
+        glm::vec3 v = m_particles.velocity.get(i);
+        if ( invDt > 0.0f && m_particles.active[i] && !m_particles.fixed[i] )
+            v = (m_particles.position.get(i) - m_particles.previousPosition.get(i))*invDt;
+        dst[3*i + 0] = v.x;
+        dst[3*i + 1] = v.y;
+        dst[3*i + 2] = v.z;
+    }
+}
+
+void ParticleSystem::copyLife( float* dst ) const {
+    std::copy( m_particles.life.begin(), m_particles.life.begin() + m_numParticles, dst );
+}
+
+int ParticleSystem::getNumParticles( ) const {
+    return m_numParticles;
+}
+
+int ParticleSystem::getNumSceneParticles( ) const {
+    return m_numSceneParticles;
+}
+
+
+void ParticleSystem::setEmitterCapacity( int capacity ){
+    m_emitterCapacity = std::max( 0, capacity );
+    m_particles.resize( m_numSceneParticles + m_emitterCapacity );
+    m_emitted.reset( m_particles, m_numSceneParticles, m_emitterCapacity );
+    // the emitted particles have no springs, but the gather pass reads their (empty) lists
+    m_springs.buildAdjacency( m_numSceneParticles + m_emitterCapacity );
+    m_numParticles = m_numSceneParticles;
+    m_gridCurrent = false;
+}
+
+int ParticleSystem::getEmitterCapacity( ) const {
+    return m_emitterCapacity;
+}
+
+int ParticleSystem::addEmitter( const EmitterSettings& settings ){
+    m_emitters.push_back( ParticleEmitter( settings ) );
+    m_emitters.back().restart( m_seed, m_emitters.size() );
+    return (int) m_emitters.size() - 1;
 }
 
+ParticleEmitter& ParticleSystem::getEmitter( int i ){
+    return m_emitters[i];
+}
+
+int ParticleSystem::getNumEmitters( ) const {
+    return (int) m_emitters.size();
+}
+
+void ParticleSystem::clearEmitters( ){
+    m_emitters.clear();
+}
+
+int ParticleSystem::getNumEmitted( ) const {
+    return m_emitted.getNumAlive();
+}
+
+void ParticleSystem::emitParticles( float dt ){
+    if ( m_emitterCapacity == 0 ) return;
+
+    // the expired particles go first, so that a steady emitter refills
+    // their slots in place and compact() has nothing left to move
+    for (int i = m_emitted.getFirst(); i < m_emitted.getEnd(); i++)
+        if ( m_emitted.isAlive(i) && m_particles.life[i] >= m_particles.lifetime[i] )
+            m_emitted.release( m_particles, i );
+
+    for (ParticleEmitter& emitter : m_emitters)
+    {
+        int count = emitter.take( dt );
+        for (int k = 0; k < count; k++)
+        {
+            int i = m_emitted.allocate();
+            if ( i < 0 ) break;
+            spawnParticle( i, emitter, dt );
+        }
+    }
+
+    m_emitted.compact( m_particles );
+    m_numParticles = m_emitted.getEnd();
+}
+
+void ParticleSystem::spawnParticle( int i, ParticleEmitter& emitter, float dt ){
+    glm::vec3 position, velocity;
+    float lifetime;
+    emitter.sample( &position, &velocity, &lifetime );
+
+    const EmitterSettings& settings = emitter.getSettings();
+    m_particles.position.set( i, position );
+    // Verlet reads the velocity from the previous position
+    m_particles.previousPosition.set( i, position - velocity*dt );
+    m_particles.velocity.set( i, velocity );
+    m_particles.force.set( i, glm::vec3(0, -9.81f*GF, 0) );
+    m_particles.setMass( i, settings.mass );
+    m_particles.damping[ i ]  = m_damping;
+    m_particles.bouncing[ i ] = settings.bouncing;
+    m_particles.lifetime[ i ] = lifetime;
+    m_particles.life[ i ]     = 0.0f;
+    m_particles.fixed[ i ]    = 0;
+    m_particles.active[ i ]   = 1;
+}
+
+
 void ParticleSystem::iniParticleSystem( ){
+    m_springs.clear();
+    m_gridCurrent = false;
+
+    switch ( m_systemType )
+    {
+    case ParticleSystemType::Cloth:
+    {
+        // hanging sheet, rows going down from y = 5, pinned at the top corners
+        int nx = std::max( 1, (int) std::lround( std::sqrt( (float) m_numSceneParticles ) ) );
+        int ny = (m_numSceneParticles + nx - 1) / nx;
+        int side = std::max( nx, ny );
+        float spacing = side > 1 ? std::min( Long, 10.0f/(side - 1) ) : Long;
+        iniLattice( nx, ny, 1, spacing, glm::vec3( -0.5f*spacing*(nx - 1), 5.0f, 0.0f ) );
+        for (int corner : { 0, nx - 1 })
+            if ( corner < m_numSceneParticles ) m_particles.fixed[ corner ] = 1;
+        break;
+    }
+    case ParticleSystemType::SoftBody:
+    {
+        // free cube (last layer possibly partial) beside the sphere
+        int nx = std::max( 1, (int) std::lround( std::cbrt( (float) m_numSceneParticles ) ) );
+        int nz = (m_numSceneParticles + nx*nx - 1) / (nx*nx);
+        int side = std::max( nx, nz );
+        float spacing = side > 1 ? std::min( Long, 4.0f/(side - 1) ) : Long;
+        iniLattice( nx, nx, nz, spacing, glm::vec3( -3.0f - 0.5f*spacing*(nx - 1), 4.0f, -0.5f*spacing*(nz - 1) ) );
+        break;
+    }
+    default:
+        iniRope( );
+        break;
+    }
+
+    // the coloring (XPBD) and the implicit pattern are built on first use
+    m_springs.buildAdjacency( m_numSceneParticles + m_emitterCapacity );
+
+    std::fill( m_particles.damping.begin(), m_particles.damping.end(), m_damping );
+
+    // the scene lives 10 to 20 s (see the life pass in stepRange); a reset
+    // replays the same lifetimes and emission
+    RandomStream lifetimes( m_seed, 0 );
+    lifetimes.fillUniform( m_particles.lifetime.data(), m_numSceneParticles, 10.0f, 20.0f );
+    std::fill( m_particles.life.begin(), m_particles.life.begin() + m_numSceneParticles, 0.0f );
+    for (size_t k = 0; k < m_emitters.size(); k++)
+        m_emitters[k].restart( m_seed, k + 1 );
+
+    m_emitted.reset( m_particles, m_numSceneParticles, m_emitterCapacity );
+    m_numParticles = m_numSceneParticles;
+    m_verletDt = 0.0f;
+    m_lastDt   = 0.0f;
+}
+
+void ParticleSystem::iniRope( ){
     bool partHori = 1;
     if (partHori)
     {
@@ -78,131 +330,416 @@ void ParticleSystem::iniParticleSystem( ){
         float Xp = -4.0;
         float Yp = 0.0;
         float Zp = 0.0;
-        m_particleSystem[ 0 ].setFixed( true );
-        m_particleSystem[ 0 ].setPosition(Xp, Yp, Zp);
+        m_particles.fixed[ 0 ] = 1;
+        m_particles.position.set( 0, glm::vec3(Xp, Yp, Zp) );
+        m_particles.previousPosition.set( 0, glm::vec3(Xp, Yp, Zp) );
 
-        for (int i = 1; i < m_numParticles; i++)
+        for (int i = 1; i < m_numSceneParticles; i++)
         {
-            m_particleSystem[ i ].setFixed( false );
+            m_particles.fixed[ i ] = 0;
 
-            m_particleSystem[ i ].setPosition(Xp + 1.1*Long*float(i), Yp, Zp);
-            m_particleSystem[ i ].setVelocity(0.0, 0.0, 0.0);
-            m_particleSystem[ i ].setForce(0, -9.81f*GF, 0);
+            m_particles.position.set( i, glm::vec3(Xp + 1.1*Long*float(i), Yp, Zp) );
+            m_particles.previousPosition.set( i, m_particles.position.get(i) );
+            m_particles.velocity.set( i, glm::vec3(0.0f) );
+            m_particles.force.set( i, glm::vec3(0, -9.81f*GF, 0) );
 
-            m_particleSystem[ i ].setMass( 0.1 );
-            m_particleSystem[ i ].setBouncing( 1.0 ); //1.3
+            m_particles.setMass( i, 0.1f );
+            m_particles.bouncing[ i ] = 1.0f; //1.3
 
         }
-        //m_particleSystem[ m_numParticles-1 ].setFixed( true );
+        //m_particles.fixed[ m_numSceneParticles-1 ] = 1;
     }
     else {
         float Xp = 1.0;
         float Yp = 2.0;
         float Zp = 0.0;
-        m_particleSystem[ 0 ].setFixed( true );
-        m_particleSystem[ 0 ].setPosition(Xp, Yp, Zp);
+        m_particles.fixed[ 0 ] = 1;
+        m_particles.position.set( 0, glm::vec3(Xp, Yp, Zp) );
+        m_particles.previousPosition.set( 0, glm::vec3(Xp, Yp, Zp) );
 
-        for (int i = 1; i < m_numParticles; i++)
+        for (int i = 1; i < m_numSceneParticles; i++)
         {
-            m_particleSystem[ i ].setFixed( false );
+            m_particles.fixed[ i ] = 0;
 
-            m_particleSystem[ i ].setPosition(Xp , Yp - 1.1*Long*float(i), Zp);
-            m_particleSystem[ i ].setVelocity(0.0, 0.0, 0.0);
-            m_particleSystem[ i ].setForce(0, -9.81f*GF, 0);
+            m_particles.position.set( i, glm::vec3(Xp , Yp - 1.1*Long*float(i), Zp) );
+            m_particles.previousPosition.set( i, m_particles.position.get(i) );
+            m_particles.velocity.set( i, glm::vec3(0.0f) );
+            m_particles.force.set( i, glm::vec3(0, -9.81f*GF, 0) );
 
-            m_particleSystem[ i ].setMass( 0.1 );
-            m_particleSystem[ i ].setBouncing( 1.0 );
+            m_particles.setMass( i, 0.1f );
+            m_particles.bouncing[ i ] = 1.0f;
 
         }
-        //m_particleSystem[ m_numParticles-1 ].setFixed( true );
+        //m_particles.fixed[ m_numSceneParticles-1 ] = 1;
+    }
+
+    // spring i joins particles i and i+1
+    SpringCoefficients none = { 0.0f, 0.0f };
+    m_springs.addLattice( 0, m_numSceneParticles, 1, 1, m_numSceneParticles, Long, springCoefficients( SpringType::Structural ), none, none );
+}
+
+// particle (x, y, z) of the block is x + nx*(y + ny*z), placed at origin + spacing*(x, -y, z)
+void ParticleSystem::iniLattice( int nx, int ny, int nz, float spacing, glm::vec3 origin ){
+    for (int i = 0; i < m_numSceneParticles; i++)
+    {
+        int x = i % nx;
+        int y = (i / nx) % ny;
+        int z = i / (nx*ny);
+        glm::vec3 p = origin + spacing*glm::vec3( x, -y, z );
+
+        m_particles.fixed[ i ] = 0;
+        m_particles.position.set( i, p );
+        m_particles.previousPosition.set( i, p );
+        m_particles.velocity.set( i, glm::vec3(0.0f) );
+        m_particles.force.set( i, glm::vec3(0, -9.81f*GF, 0) );
+
+        m_particles.setMass( i, 0.1f );
+        m_particles.bouncing[ i ] = 1.0f;
     }
+
+    SpringCoefficients structural = springCoefficients( SpringType::Structural );
+    m_springs.addLattice( 0, nx, ny, nz, m_numSceneParticles, spacing, structural, structural,
+                          springCoefficients( SpringType::Bending ) );
 }
 
 glm::vec3 ParticleSystem::getSpringForce( int i )
 {
-    Particle P1 = m_particleSystem[ i   ];
-    Particle P2 = m_particleSystem[ i+1 ];
-
-    glm::vec3 dPos = P1.getCurrentPosition() - P2.getCurrentPosition();
-    float     dist = glm::length( dPos );
+    if ( i < 0 || i >= m_springs.getNumSprings() ) return glm::vec3( 0.0f );
+    syncVelocities( );
+    return m_springs.getForce( i, m_particles.position, m_particles.velocity );
+}
 
-    glm::vec3 nDir = dPos / dist;
-    glm::vec3 dVec = P2.getVelocity() - P1.getVelocity();
+const SpringNetwork& ParticleSystem::getSprings( ) const {
+    return m_springs;
+}
 
-    if ( dist > 0 ) // that equation
-    {
-        return ( k_e*(dist - Long) + k_d*( glm::dot( dVec, nDir ) ) ) * nDir;
-    }
 
-    return glm::vec3( 0.0f );
+// True if collideParticle(i) would change particle i. A particle that hits
+// nothing before any correction hits nothing after either, so only the
+// flagged particles need the (sequential) correction.
+bool ParticleSystem::detectCollision( int i ) const
+{
+    return m_colliders.crosses( m_particles.previousPosition.get(i), m_particles.position.get(i) );
 }
 
+void ParticleSystem::collideParticle( int i, float dt, bool verlet )
+{
+    if ( verlet ) deriveVelocities( i, i + 1, dt );
+
+    glm::vec3 pos = m_particles.position.get(i);
+    glm::vec3 vel = m_particles.velocity.get(i);
+    m_colliders.collide( m_particles.previousPosition.get(i), pos, vel, m_particles.bouncing[i] );
+    m_particles.position.set(i, pos);
+    m_particles.velocity.set(i, vel);
+
+    if ( verlet ) storeVelocities( i, i + 1, dt );
+}
 
 
 void ParticleSystem::updateParticleSystem(const float& dt, Particle::UpdateMethod method){
-    glm::vec3 F_spring;     //force of the current spring
-    for (int i = 0; i < m_numParticles; i++)
+    PROFILE_STEP( m_profiler );
+
+    // XPBD predicts with the external forces only and projects the springs
+    // and colliders as constraints after the integration (Pass 2b)
+    const bool xpbd = method == Particle::UpdateMethod::XPBD;
+    m_gridCurrent = false;
+
+    // Verlet keeps its velocity in position - previousPosition (the spring
+    // damping derives it on the fly); the other methods need the array
+    const bool verlet = method == Particle::UpdateMethod::Verlet;
+    if ( !verlet ) syncVelocities( );
+
+    // position - previousPosition spans the last step, whatever its method:
+    // when the step changes (adaptive substeps, a toggled controller) it is
+    // rescaled, or Verlet would scale the velocity by lastDt/dt
+    if ( verlet && m_lastDt > 0.0f && m_lastDt != dt ) {
+        const float scale = dt / m_lastDt;
+        if ( m_pool ) {
+            m_pool->parallelFor( 0, m_numParticles, 4096, [&]( int begin, int end ) {
+                rescaleDisplacements( begin, end, scale );
+            });
+        }
+        else {
+            rescaleDisplacements( 0, m_numParticles, scale );
+        }
+    }
+
+    emitParticles( dt );
+
+    // Pass 1a: one sweep over the springs
+    const int numSprings = xpbd ? 0 : m_springs.getNumSprings();
+    m_springForce.resize( numSprings );
     {
-        m_particleSystem[i].setForce(0.0f, -9.81f, 0.0f);
+        PROFILE_STEP_PHASE( m_profiler, StepPhase::Springs );
+        auto springs = [&]( int begin, int end ) {
+            if ( verlet )
+                m_springs.computeForces( m_particles.position, m_particles.previousPosition, 1.0f / dt, begin, end, m_springForce );
+            else
+                m_springs.computeForces( m_particles.position, m_particles.velocity, begin, end, m_springForce );
+        };
+        if ( m_pool ) m_pool->parallelFor( 0, numSprings, 4096, springs );
+        else          springs( 0, numSprings );
+    }
 
-        if (i==0) {
-            m_particleSystem[i].setFixed(true);
-            F_spring = getSpringForce( i );
-        }
-        else if (i == m_numParticles - 1) {
-            m_particleSystem[i].addForce( -F_spring ); // force up
+    // Pass 1b: forces (gravity plus the springs of each particle, through the CSR adjacency)
+    {
+        PROFILE_STEP_PHASE( m_profiler, StepPhase::Forces );
+        if ( m_pool ) {
+            m_pool->parallelFor( 0, m_numParticles, 4096, [&]( int begin, int end ) {
+                accumulateForces( begin, end, !xpbd );
+            });
         }
         else {
-            m_particleSystem[i].addForce( -F_spring ); // force up
-            F_spring = getSpringForce( i ); // next spring
-            m_particleSystem[i].addForce(  F_spring ); // force down
+            accumulateForces( 0, m_numParticles, !xpbd );
         }
-        m_particleSystem[i].setForce( m_particleSystem[i].getForce().x*GF, m_particleSystem[i].getForce().y*GF, m_particleSystem[i].getForce().z*GF );
+    }
 
-        //std::cout << "FS(" << i << ") = {" << F_spring.x << ", " << F_spring.y << ", " << F_spring.z << "}\n" ;
+
+    // Pass 1c: backward Euler turns the forces into implicit accelerations.
+    // Only the scene particles have springs: the emitted ones keep dv = dt*f,
+    // and their count, which changes every step, never touches the pattern
+    if ( method == Particle::UpdateMethod::Implicit ) {
+        PROFILE_STEP_PHASE( m_profiler, StepPhase::ImplicitSolve );
+        m_implicit.solve( m_springs, GF, m_particles, m_numSceneParticles, dt );
     }
-    //std::cout << std::endl;
 
+    // Pass 2: life, integration and collisions; particles are independent here,
+    // so the range is split into cache-line aligned chunks across the pool
+    m_collisionHit.resize( m_numParticles );
+    IntegrationKernel integrate = selectIntegrationKernel( method );
+    if ( m_pool ) {
+        m_pool->parallelFor( 0, m_numParticles, 4096, [&]( int begin, int end ) {
+            stepRange( begin, end, dt, method, integrate );
+        });
+    }
+    else {
+        stepRange( 0, m_numParticles, dt, method, integrate );
+    }
 
-    for (int i = 0; i < m_numParticles; i++)
+    // Pass 2b: XPBD projects the springs and the colliders on the predicted positions
+    if ( xpbd ) {
+        PROFILE_STEP_PHASE( m_profiler, StepPhase::Constraints );
+        if ( m_xpbd.getSweep() == XpbdSolver::Sweep::Colored && !m_springs.hasColoring() )
+            m_springs.buildColoring( );
+        m_xpbd.solve( m_springs, GF, m_particles, m_numParticles, dt, m_colliders, m_pool.get() );
+    }
+
+    // Pass 3: particle-particle contacts through the neighbor grid
+    if ( m_particleCollisions && m_particleRadius > 0.0f )
+        collideParticles( dt, verlet );
+
+    m_verletDt = verlet ? dt : 0.0f;
+    m_lastDt   = dt;
+}
+
+void ParticleSystem::rescaleDisplacements( int begin, int end, float scale ){
+    for (int i = begin; i < end; i++)
     {
+        if ( m_particles.fixed[i] ) continue;
+        glm::vec3 x = m_particles.position.get(i);
+        m_particles.previousPosition.set( i, x - (x - m_particles.previousPosition.get(i))*scale );
+    }
+}
 
-        /* ******** LIFE SYSTEM IS "DEAD" ******** */
-        if ( m_particleSystem[i].getLife() >= m_particleSystem[i].getLifetime() )
-        {   // reset speed + life
-            m_particleSystem[i].setLife(0.0f);
-        }
-        else {
-            m_particleSystem[i].updateParticle(dt, method);
+void ParticleSystem::deriveVelocities( int begin, int end, float dt ){
+    const float invDt = 1.0f / dt;
+    for (int i = begin; i < end; i++)
+    {
+        if ( !m_particles.active[i] || m_particles.fixed[i] ) continue;
+        m_particles.velocity.set( i, (m_particles.position.get(i) - m_particles.previousPosition.get(i))*invDt );
+    }
+}
 
+void ParticleSystem::storeVelocities( int begin, int end, float dt ){
+    for (int i = begin; i < end; i++)
+    {
+        if ( !m_particles.active[i] || m_particles.fixed[i] ) continue;
+        m_particles.previousPosition.set( i, m_particles.position.get(i) - m_particles.velocity.get(i)*dt );
+    }
+}
 
-            //Check Floor collisions
-            if ( m_particleSystem[i].collisionParticlePlane( floorPlane ) ){
-                m_particleSystem[i].correctCollisionParticlePlane( floorPlane );
-            }
-            if ( m_particleSystem[i].collisionParticlePlane( leftWallPlane ) ){
-                m_particleSystem[i].correctCollisionParticlePlane( leftWallPlane );
-            }
-            if ( m_particleSystem[i].collisionParticlePlane( rightWallPlane ) ){
-                m_particleSystem[i].correctCollisionParticlePlane( rightWallPlane );
-            }
-            if ( m_particleSystem[i].collisionParticlePlane( frontWallPlane ) ){
-                m_particleSystem[i].correctCollisionParticlePlane( frontWallPlane  );
+void ParticleSystem::syncVelocities( ){
+    if ( m_verletDt <= 0.0f ) return;
+    const float dt = m_verletDt;
+    if ( m_pool ) {
+        m_pool->parallelFor( 0, m_numParticles, 4096, [&]( int begin, int end ) {
+            deriveVelocities( begin, end, dt );
+        });
+    }
+    else {
+        deriveVelocities( 0, m_numParticles, dt );
+    }
+    m_verletDt = 0.0f;
+}
+
+ImplicitSpringSolver& ParticleSystem::getImplicitSolver( ){
+    return m_implicit;
+}
+
+XpbdSolver& ParticleSystem::getXpbdSolver( ){
+    return m_xpbd;
+}
+
+AdaptiveStepper& ParticleSystem::getStepper( ){
+    return m_stepper;
+}
+
+ColliderSet& ParticleSystem::getColliders( ){
+    return m_colliders;
+}
+
+int ParticleSystem::advance( float frameDt, Particle::UpdateMethod method ){
+    syncVelocities( );
+
+    // boxes and meshes are tested continuously: only spheres, and with
+    // contacts on the grid cell, bound the step
+    float length = m_colliders.getSmallestSize();
+    if ( m_particleCollisions && m_particleRadius > 0.0f )
+        length = std::min( length, m_grid.getCellSize() );
+
+    StepLimits limits = m_stepper.estimate( m_springs, m_particles, m_numParticles, GF, length, method );
+    int substeps = m_stepper.chooseSubsteps( limits, frameDt );
+    for (int k = 0; k < substeps; k++)
+        updateParticleSystem( frameDt / substeps, method );
+    return substeps;
+}
+
+StepTimings ParticleSystem::takeStepTimings( ){
+#ifdef PARTICLES_PROFILE
+    return m_profiler.take();
+#else
+    return StepTimings();
+#endif
+}
+
+void ParticleSystem::collideParticles( float dt, bool verlet ){
+    m_contactDx.resize( m_numParticles );
+    m_contactDv.resize( m_numParticles );
+
+    {
+        PROFILE_STEP_PHASE( m_profiler, StepPhase::CollisionDetection );
+        if ( verlet ) {
+            if ( m_pool ) {
+                m_pool->parallelFor( 0, m_numParticles, 4096, [&]( int begin, int end ) {
+                    deriveVelocities( begin, end, dt );
+                });
             }
-            if ( m_particleSystem[i].collisionParticlePlane( backWallPlane ) ){
-                m_particleSystem[i].correctCollisionParticlePlane( backWallPlane );
+            else {
+                deriveVelocities( 0, m_numParticles, dt );
             }
+        }
+        m_grid.build( m_particles.position, m_numParticles, m_particles.active.data() );
 
-            //Check SPHERE collisions
-            if ( m_particleSystem[i].collisionParticleSphere( sph ) ){
-                std::cout << "SPHERE[" << i << "]\n";
-                m_particleSystem[i].correctCollisionParticleSphere( sph );
-            }
+        // Jacobi: every particle only writes its own correction, so this is parallel safe
+        if ( m_pool ) {
+            m_pool->parallelFor( 0, m_numParticles, 1024, [this]( int begin, int end ) {
+                collideParticlesRange( begin, end );
+            });
+        }
+        else {
+            collideParticlesRange( 0, m_numParticles );
+        }
+    }
 
+    PROFILE_STEP_PHASE( m_profiler, StepPhase::CollisionCorrection );
+    for (int i = 0; i < m_numParticles; i++)
+    {
+        if ( !m_particles.active[i] || m_particles.fixed[i] ) continue;
+        m_particles.position.set( i, m_particles.position.get(i) + m_contactDx.get(i) );
+        m_particles.velocity.set( i, m_particles.velocity.get(i) + m_contactDv.get(i) );
+    }
+    if ( verlet ) storeVelocities( 0, m_numParticles, dt );
+}
 
+// Sphere-sphere contact between particle i and its grid neighbors: the
+// overlap is split by inverse mass and the approaching normal velocity is
+// reflected with the average bouncing of the pair.
+void ParticleSystem::collideParticlesRange( int begin, int end ){
+    const float diameter = 2.0f*m_particleRadius;
+    const Vec3Array& pos = m_particles.position;
+    const Vec3Array& vel = m_particles.velocity;
 
-            m_particleSystem[i].addLife( dt );
+    for (int i = begin; i < end; i++)
+    {
+        glm::vec3 dx( 0.0f ), dv( 0.0f );
+        if ( m_particles.active[i] && !m_particles.fixed[i] )
+        {
+            const glm::vec3 pi = pos.get(i);
+            const glm::vec3 vi = vel.get(i);
+            const float wi = m_particles.invMass[i];
+
+            m_grid.forEachNeighbor( pos, pi, diameter, [&]( int j ) {
+                if ( j == i ) return;
+                glm::vec3 d = pi - pos.get(j);
+                float dist = glm::length( d );
+                if ( dist <= 0.0f ) return;
+
+                glm::vec3 n  = d / dist;
+                float     wj = m_particles.fixed[j] ? 0.0f : m_particles.invMass[j];
+                float share  = wi / (wi + wj);
+
+                dx += share*( diameter - dist )*n;
+
+                float vn = glm::dot( vi - vel.get(j), n );
+                if ( vn < 0.0f ) {
+                    float e = 0.5f*( m_particles.bouncing[i] + m_particles.bouncing[j] );
+                    dv -= share*( 1.0f + e )*vn*n;
+                }
+            });
         }
+        m_contactDx.set( i, dx );
+        m_contactDv.set( i, dv );
     }
 }
 
+void ParticleSystem::accumulateForces( int begin, int end, bool springs ){
+    for (int i = begin; i < end; i++)
+        m_particles.force.set( i, glm::vec3(0.0f, -9.81f, 0.0f) );
+
+    if ( springs )
+        m_springs.gatherForces( m_springForce, begin, end, m_particles.force );
+
+    for (int i = begin; i < end; i++)
+        m_particles.force.set( i, m_particles.force.get(i)*GF );
+}
+
+void ParticleSystem::stepRange( int begin, int end, const float& dt, Particle::UpdateMethod method, IntegrationKernel integrate ){
+    // XPBD projects the collisions afterwards, as constraints
+    const bool collide = method != Particle::UpdateMethod::XPBD;
+    const bool verlet  = method == Particle::UpdateMethod::Verlet;
+    std::vector<float>&        life   = m_particles.life;
+    std::vector<std::uint8_t>& active = m_particles.active;
+    {
+        PROFILE_STEP_PHASE( m_profiler, StepPhase::Integration );
+
+        /* ******** LIFE SYSTEM IS "DEAD" ******** */
+        // (for the scene: emitParticles() recycles the emitted particles
+        // before they get here)
+        for (int i = begin; i < end; i++)
+        {
+            active[i] = life[i] < m_particles.lifetime[i];
+            if ( !active[i] )
+            {   // reset speed + life
+                life[i] = 0.0f;
+            }
+        }
+
+        // integration, 4/8 particles at a time
+        integrate( IntegrationArrays( m_particles ), begin, end, dt );
+    }
+
+    {
+        PROFILE_STEP_PHASE( m_profiler, StepPhase::CollisionDetection );
+        for (int i = begin; i < end; i++)
+            m_collisionHit[i] = collide && active[i] && detectCollision( i );
+    }
+
+    // collisions + aging of the simulated particles
+    PROFILE_STEP_PHASE( m_profiler, StepPhase::CollisionCorrection );
+    for (int i = begin; i < end; i++)
+    {
+        if (!active[i]) continue;
+        if ( m_collisionHit[i] ) collideParticle( i, dt, verlet );
+        life[i] += dt;
+    }
+}
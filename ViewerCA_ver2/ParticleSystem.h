@@ -1,50 +1,185 @@
 #pragma once
 #include "Particle.h"
+#include "ParticleStore.h"
+#include "ParticleKernels.h"
+#include <memory>
 #include <vector>
-#include "Plane.h"
-#include "Sphere.h"
-//#include "Triangle.h"
+#include "Colliders.h"
+#include "ParticleEmitter.h"
+#include "ParticlePool.h"
+#include "SpatialGrid.h"
+#include "SpringNetwork.h"
+#include "ImplicitSolver.h"
+#include "XpbdSolver.h"
+#include "AdaptiveStepper.h"
+#include "StepProfiler.h"
+
+class ThreadPool;
 
 class ParticleSystem
 {
 public:
-    enum class ParticleSystemType : std::int8_t { Fountain, Waterfall };
+    // Fountain and Waterfall are a rope pinned at one end; Cloth is a sheet
+    // pinned at its top corners; SoftBody a free block of particles
+    enum class ParticleSystemType : std::int8_t { Fountain, Waterfall, Cloth, SoftBody };
 	ParticleSystem();
 	~ParticleSystem();
+    // puts numParticles particles of the scene back in place, followed by the
+    // slots of the emitters (all dead); the store only grows
     void setParticleSystem(int numParticles, ParticleSystemType systemType = ParticleSystemType::Fountain);
 	Particle getParticle(int i);
+    glm::vec3 getPosition( int i ) const;
+    // writes x,y,z of every particle, interleaved, into dst[0 .. 3*getNumParticles())
+    void copyPositions( float* dst ) const;
+    // the same for the velocities, derived from the positions after Verlet
+    // steps, and for the ages (life, in seconds; one float per particle)
+    void copyVelocities( float* dst ) const;
+    void copyLife( float* dst ) const;
+    // the particles of the scene, then the live emitted ones
+    int getNumParticles( ) const;
+    int getNumSceneParticles( ) const;
+    // force of spring i on its first particle (on a rope, spring i joins particles i and i+1)
     glm::vec3 getSpringForce( int i );
+    const SpringNetwork& getSprings( ) const;
 
     void iniParticleSystem( );
     void updateParticleSystem(const float& dt, Particle::UpdateMethod method = Particle::UpdateMethod::EulerOrig);
+    // advances frameDt in as many equal updateParticleSystem() substeps as
+    // getStepper() estimates the current state needs; returns that count
+    int advance( float frameDt, Particle::UpdateMethod method = Particle::UpdateMethod::EulerOrig );
 
+    // damping and elasticity also change the springs in place; the length
+    // is the spacing of the next setParticleSystem(). Elasticity keeps the
+    // sign of the UI (negative pulls particles together)
     void setSpringDamping( float val );
     void setSpringElasticity( float val );
     void setSpringLength( float val );
 
+    // Verlet damping of the particles of the next setParticleSystem(): the
+    // fraction of the last step's displacement lost per step (kDefaultDamping)
+    void setDamping( float val );
+
+    // particle-particle collisions; the neighbor grid cell size follows the radius
+    void setParticleRadius( float radius );
+    float getParticleRadius( ) const;
+    void setParticleCollisions( bool enabled );
+
+    // particles within radius of particle i (excluding i), any radius; the
+    // first query after a step rebuilds the neighbor grid from the current
+    // positions
+    void getNeighbors( int i, float radius, std::vector<int>& out );
+
+    // Emitted particles: capacity slots after the particles of the scene,
+    // filled by the emitters at the start of every step and recycled once
+    // their lifetime runs out (see ParticlePool); emission beyond the
+    // capacity is dropped. Changing the capacity kills the emitted particles.
+    void setEmitterCapacity( int capacity );
+    int getEmitterCapacity( ) const;
+    int addEmitter( const EmitterSettings& settings );
+    ParticleEmitter& getEmitter( int i );
+    int getNumEmitters( ) const;
+    void clearEmitters( );
+    int getNumEmitted( ) const;
+
+    // the seed of the lifetimes of the scene and of the emitters; takes
+    // effect at the next setParticleSystem(), and a seed replays a run bit
+    // for bit whatever the number of threads (default 1)
+    void setSeed( std::uint64_t seed );
+    std::uint64_t getSeed( ) const;
+
+    // threads used by updateParticleSystem (1: serial, the default; <= 0: one per core)
+    void setNumThreads( int numThreads );
+    int getNumThreads( ) const;
+
+    // CG settings of the Implicit method
+    ImplicitSpringSolver& getImplicitSolver( );
+    // iterations and sweep of the XPBD method
+    XpbdSolver& getXpbdSolver( );
+    // tolerance and limits of advance()
+    AdaptiveStepper& getStepper( );
+    // what the particles collide with; the box walls and the sphere by default
+    ColliderSet& getColliders( );
+
+    // per-phase times of the steps since the previous call (all zero unless
+    // built with PARTICLES_PROFILE, see StepProfiler.h)
+    StepTimings takeStepTimings( );
+
 private:
-	int m_numParticles;
-	std::vector<Particle> m_particleSystem;
+    // kills the expired emitted particles, spawns the new ones and compacts
+    void emitParticles( float dt );
+    void spawnParticle( int i, ParticleEmitter& emitter, float dt );
+    // spring coefficients from k_e, k_d and the type of each spring
+    SpringCoefficients springCoefficients( SpringType type ) const;
+    void iniRope( );
+    void iniLattice( int nx, int ny, int nz, float spacing, glm::vec3 origin );
+    // gravity, plus the springs unless springs is false
+    void accumulateForces( int begin, int end, bool springs );
+    void stepRange( int begin, int end, const float& dt, Particle::UpdateMethod method, IntegrationKernel integrate );
+    bool detectCollision( int i ) const;
+    // verlet: the velocity lives in position - previousPosition, so it is
+    // derived before the response and written back into previousPosition after
+    void collideParticle( int i, float dt, bool verlet );
+    void collideParticlesRange( int begin, int end );
+    void collideParticles( float dt, bool verlet );
+    // velocity = (position - previousPosition)/dt in [begin, end), and the converse
+    void deriveVelocities( int begin, int end, float dt );
+    void storeVelocities( int begin, int end, float dt );
+    // position - previousPosition *= scale in [begin, end)
+    void rescaleDisplacements( int begin, int end, float scale );
+    // brings the velocity array up to date after Verlet steps
+    void syncVelocities( );
+
+    // every random number of the system comes from a RandomStream of this
+    // seed: stream 0 the lifetimes of the scene, stream 1 + k emitter k
+    std::uint64_t m_seed;
 
-    // box walls
-    Plane floorPlane;
-    Plane leftWallPlane;
-    Plane rightWallPlane;
-    Plane frontWallPlane;
-    Plane backWallPlane;
+	int m_numParticles;        // simulated: the scene, then the live emitted particles
+    int m_numSceneParticles;
+    ParticleSystemType m_systemType;
+	ParticleStore m_particles; // SoA: one array per attribute
 
-    // extra objects to collide with
-    Sphere sph;
+    std::vector<ParticleEmitter> m_emitters;
+    ParticlePool m_emitted;    // the slots after the scene
+    int m_emitterCapacity;
 
-    //Triangle tri DEPRECATERINO
-    glm::vec3 t1, t2, t3;
+    // box walls, then the objects inside
+    ColliderSet m_colliders;
 
-    // global spring information (read: all springs have equal stats)
+    // coefficients for new springs; each spring keeps its own in m_springs
     float k_e;  //elasticity
     float k_d;  //dampening
     float Long; //longitude (between 2 particles)
+    float m_damping;
+
+    // dt of the last step if it was Verlet (velocity array stale), else 0
+    float m_verletDt;
+    // dt of the last step, whatever its method; 0 before the first
+    float m_lastDt;
 
     float GF;
+    SpringNetwork m_springs;
+    Vec3Array m_springForce; // force of spring s on its first particle
+    ImplicitSpringSolver m_implicit;
+    XpbdSolver m_xpbd;
+    AdaptiveStepper m_stepper;
+
+    // set by the detection pass for particles that need collideParticle()
+    std::vector<std::uint8_t> m_collisionHit;
+
+    // particle-particle collisions
+    float m_particleRadius;
+    bool  m_particleCollisions;
+    SpatialGrid m_grid;
+    bool  m_gridCurrent; // m_grid holds the current positions
+    Vec3Array m_contactDx; // per-particle position/velocity corrections (Jacobi)
+    Vec3Array m_contactDv;
+
+    // persistent workers for the per-particle passes (null when serial)
+    std::unique_ptr<ThreadPool> m_pool;
+
+#ifdef PARTICLES_PROFILE
+    StepProfiler m_profiler;
+#endif
 
 };
 
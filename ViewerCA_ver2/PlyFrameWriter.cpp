@@ -0,0 +1,111 @@
+#include "PlyFrameWriter.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "mesh_io.h"
+
+
+namespace {
+
+const int kFloatsPerParticle = 7; // x, y, z, vx, vy, vz, life
+
+}  // namespace
+
+
+PlyFrameWriter::PlyFrameWriter(const std::string& pattern, int stride) :
+m_valid(false), m_stride(std::max(stride, 1))
+{
+    // the pattern comes from the user: only the conversion found here, at
+    // most 2 width digits, ever reaches snprintf
+    int conversions = 0;
+    std::string literal;
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        if (pattern[i] != '%')
+        {
+            literal += pattern[i];
+            continue;
+        }
+        if (i + 1 < pattern.size() && pattern[i + 1] == '%')
+        {
+            literal += '%';
+            i++;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9') end++;
+        if (end == pattern.size() || pattern[end] != 'd' || end - i > 3 || ++conversions > 1) return;
+        m_prefix = literal;
+        m_conversion = pattern.substr(i, end - i + 1);
+        literal.clear();
+        i = end;
+    }
+    m_suffix = literal;
+    m_valid = conversions == 1;
+}
+
+bool PlyFrameWriter::isValid() const
+{
+    return m_valid;
+}
+
+std::string PlyFrameWriter::filename(int step) const
+{
+    if (!m_valid) return std::string();
+    char number[128];
+    snprintf(number, sizeof(number), m_conversion.c_str(), step);
+    return m_prefix + number + m_suffix;
+}
+
+bool PlyFrameWriter::writeFrame(int step, float time, const ParticleSystem& ps)
+{
+    if (!m_valid) return false;
+    if (step % m_stride != 0) return true;
+
+    const int n = ps.getNumParticles();
+    m_positions.resize(3 * (size_t) n);
+    m_velocities.resize(3 * (size_t) n);
+    m_life.resize((size_t) n);
+    ps.copyPositions(m_positions.data());
+    ps.copyVelocities(m_velocities.data());
+    ps.copyLife(m_life.data());
+
+    // the data is in the byte order of the host
+    char header[512];
+    int headerBytes = snprintf(header, sizeof(header),
+        "ply\n"
+        "format %s 1.0\n"
+        "comment step %d\n"
+        "comment time %.9g\n"
+        "element vertex %d\n"
+        "property float x\nproperty float y\nproperty float z\n"
+        "property float vx\nproperty float vy\nproperty float vz\n"
+        "property float life\n"
+        "end_header\n",
+        data_representation::HostIsBigEndian() ? "binary_big_endian" : "binary_little_endian", step, time, n);
+
+    const size_t recordBytes = kFloatsPerParticle * sizeof(float);
+    m_buffer.resize((size_t) headerBytes + (size_t) n * recordBytes);
+    memcpy(m_buffer.data(), header, (size_t) headerBytes);
+
+    // interleave into the records
+    float record[kFloatsPerParticle];
+    char* out = m_buffer.data() + headerBytes;
+    for (int i = 0; i < n; i++)
+    {
+        record[0] = m_positions[3*i];
+        record[1] = m_positions[3*i + 1];
+        record[2] = m_positions[3*i + 2];
+        record[3] = m_velocities[3*i];
+        record[4] = m_velocities[3*i + 1];
+        record[5] = m_velocities[3*i + 2];
+        record[6] = m_life[i];
+        memcpy(out + i*recordBytes, record, recordBytes);
+    }
+
+    FILE* file = fopen(filename(step).c_str(), "wb");
+    if (file == nullptr) return false;
+    bool written = fwrite(m_buffer.data(), 1, m_buffer.size(), file) == m_buffer.size();
+    return fclose(file) == 0 && written;
+}
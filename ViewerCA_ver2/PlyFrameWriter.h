@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ParticleSystem.h"
+
+// Exports frames of a ParticleSystem as binary PLY point clouds, one file per
+// frame, for rendering in other tools. Each particle is a vertex with float
+// x, y, z, vx, vy, vz and life; the step and the time go in comments.
+//
+// A frame is assembled in a buffer kept between frames and stored with a
+// single fwrite, so dumping costs about a copy of the particles per frame.
+class PlyFrameWriter
+{
+public:
+    // pattern: path with one integer conversion for the step, %d with an
+    // optional width, as in "frames/particles_%05d.ply" (%% is a literal %);
+    // only every stride-th step is stored
+    explicit PlyFrameWriter(const std::string& pattern, int stride = 1);
+
+    // false if the pattern is not as above; nothing is written then
+    bool isValid() const;
+
+    // stores the frame if step is a multiple of the stride; false if the
+    // file could not be written
+    bool writeFrame(int step, float time, const ParticleSystem& ps);
+
+    // the file of step
+    std::string filename(int step) const;
+
+private:
+    // the pattern, split around its conversion
+    std::string m_prefix;
+    std::string m_conversion;
+    std::string m_suffix;
+    bool m_valid;
+    int m_stride;
+
+    std::vector<char>  m_buffer;
+    std::vector<float> m_positions;
+    std::vector<float> m_velocities;
+    std::vector<float> m_life;
+};
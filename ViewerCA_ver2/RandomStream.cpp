@@ -0,0 +1,230 @@
+#include "RandomStream.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <immintrin.h>
+	#define RANDOM_STREAM_SSE2 1
+#endif
+
+#if defined(RANDOM_STREAM_SSE2) && (defined(__GNUC__) || defined(__clang__))
+	#define RANDOM_STREAM_AVX2 1
+	#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+
+namespace {
+
+const std::uint32_t kMul0  = 0xD2511F53u;
+const std::uint32_t kMul1  = 0xCD9E8D57u;
+const std::uint32_t kWeyl0 = 0x9E3779B9u; // key schedule
+const std::uint32_t kWeyl1 = 0xBB67AE85u;
+const int kRounds = 10;
+
+// top 24 bits, exactly representable
+inline float toUnit(std::uint32_t x)
+{
+    return (float) (x >> 8) * (1.0f / 16777216.0f);
+}
+
+#ifdef RANDOM_STREAM_SSE2
+/* ******** SSE2: 4 blocks per instruction, word j of each block in x[j] ******** */
+
+// low and high 32 bits of the 4 products a*m
+inline void mulHiLoSSE(__m128i a, __m128i m, __m128i* lo, __m128i* hi)
+{
+    __m128i even = _mm_mul_epu32(a, m);                     // lanes 0, 2
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), m); // lanes 1, 3
+    *lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                             _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+    *hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)),
+                             _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 3, 1)));
+}
+
+// blocks counter .. counter + 3 as 16 floats lo + (hi - lo)*u, in stream order
+void philox4SSE(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter, float lo, float range, float* out)
+{
+    std::uint64_t c[4] = { counter, counter + 1, counter + 2, counter + 3 };
+    __m128i x0 = _mm_set_epi32((int) c[3], (int) c[2], (int) c[1], (int) c[0]);
+    __m128i x1 = _mm_set_epi32((int) (c[3] >> 32), (int) (c[2] >> 32), (int) (c[1] >> 32), (int) (c[0] >> 32));
+    __m128i x2 = _mm_set1_epi32((int) stream);
+    __m128i x3 = _mm_set1_epi32((int) (stream >> 32));
+    __m128i k0 = _mm_set1_epi32((int) seed);
+    __m128i k1 = _mm_set1_epi32((int) (seed >> 32));
+    const __m128i m0 = _mm_set1_epi32((int) kMul0), m1 = _mm_set1_epi32((int) kMul1);
+    const __m128i w0 = _mm_set1_epi32((int) kWeyl0), w1 = _mm_set1_epi32((int) kWeyl1);
+
+    for (int r = 0; r < kRounds; r++)
+    {
+        __m128i lo0, hi0, lo1, hi1;
+        mulHiLoSSE(x0, m0, &lo0, &hi0);
+        mulHiLoSSE(x2, m1, &lo1, &hi1);
+        x0 = _mm_xor_si128(_mm_xor_si128(hi1, x1), k0);
+        x1 = lo1;
+        x2 = _mm_xor_si128(_mm_xor_si128(hi0, x3), k1);
+        x3 = lo0;
+        k0 = _mm_add_epi32(k0, w0);
+        k1 = _mm_add_epi32(k1, w1);
+    }
+
+    const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+    const __m128 L = _mm_set1_ps(lo), R = _mm_set1_ps(range);
+    __m128 u[4];
+    __m128i x[4] = { x0, x1, x2, x3 };
+    for (int j = 0; j < 4; j++)
+    {
+        u[j] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x[j], 8)), scale);
+        u[j] = _mm_add_ps(L, _mm_mul_ps(R, u[j]));
+    }
+    // rows are words, lanes blocks: transposed, each row is a block
+    _MM_TRANSPOSE4_PS(u[0], u[1], u[2], u[3]);
+    for (int b = 0; b < 4; b++)
+        _mm_storeu_ps(out + 4*b, u[b]);
+}
+#endif
+
+#ifdef RANDOM_STREAM_AVX2
+/* ******** AVX2: 8 blocks per instruction ******** */
+
+AVX2_TARGET inline void mulHiLoAVX(__m256i a, __m256i m, __m256i* lo, __m256i* hi)
+{
+    __m256i even = _mm256_mul_epu32(a, m);
+    __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    *lo = _mm256_unpacklo_epi32(_mm256_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                _mm256_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+    *hi = _mm256_unpacklo_epi32(_mm256_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)),
+                                _mm256_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 3, 1)));
+}
+
+// blocks counter .. counter + 7 as 32 floats, in stream order
+AVX2_TARGET void philox8AVX(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter, float lo, float range, float* out)
+{
+    std::int32_t clo[8], chi[8];
+    for (int b = 0; b < 8; b++)
+    {
+        clo[b] = (std::int32_t) (counter + b);
+        chi[b] = (std::int32_t) ((counter + b) >> 32);
+    }
+    __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(clo));
+    __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chi));
+    __m256i x2 = _mm256_set1_epi32((int) stream);
+    __m256i x3 = _mm256_set1_epi32((int) (stream >> 32));
+    __m256i k0 = _mm256_set1_epi32((int) seed);
+    __m256i k1 = _mm256_set1_epi32((int) (seed >> 32));
+    const __m256i m0 = _mm256_set1_epi32((int) kMul0), m1 = _mm256_set1_epi32((int) kMul1);
+    const __m256i w0 = _mm256_set1_epi32((int) kWeyl0), w1 = _mm256_set1_epi32((int) kWeyl1);
+
+    for (int r = 0; r < kRounds; r++)
+    {
+        __m256i lo0, hi0, lo1, hi1;
+        mulHiLoAVX(x0, m0, &lo0, &hi0);
+        mulHiLoAVX(x2, m1, &lo1, &hi1);
+        x0 = _mm256_xor_si256(_mm256_xor_si256(hi1, x1), k0);
+        x1 = lo1;
+        x2 = _mm256_xor_si256(_mm256_xor_si256(hi0, x3), k1);
+        x3 = lo0;
+        k0 = _mm256_add_epi32(k0, w0);
+        k1 = _mm256_add_epi32(k1, w1);
+    }
+
+    const __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+    const __m256 L = _mm256_set1_ps(lo), R = _mm256_set1_ps(range);
+    __m128 low[4], high[4];
+    __m256i x[4] = { x0, x1, x2, x3 };
+    for (int j = 0; j < 4; j++)
+    {
+        __m256 u = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(x[j], 8)), scale);
+        u = _mm256_add_ps(L, _mm256_mul_ps(R, u));
+        low[j] = _mm256_castps256_ps128(u);
+        high[j] = _mm256_extractf128_ps(u, 1);
+    }
+    // blocks 0-3 in the low halves, 4-7 in the high ones
+    _MM_TRANSPOSE4_PS(low[0], low[1], low[2], low[3]);
+    _MM_TRANSPOSE4_PS(high[0], high[1], high[2], high[3]);
+    for (int b = 0; b < 4; b++)
+    {
+        _mm_storeu_ps(out + 4*b, low[b]);
+        _mm_storeu_ps(out + 16 + 4*b, high[b]);
+    }
+}
+
+bool hasAvx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+}  // namespace
+
+
+RandomStream::RandomStream(std::uint64_t seed, std::uint64_t stream) :
+m_seed(seed), m_stream(stream), m_counter(0), m_used(4)
+{
+}
+
+void RandomStream::block(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter, std::uint32_t out[4])
+{
+    std::uint32_t x0 = (std::uint32_t) counter, x1 = (std::uint32_t) (counter >> 32);
+    std::uint32_t x2 = (std::uint32_t) stream,  x3 = (std::uint32_t) (stream >> 32);
+    std::uint32_t k0 = (std::uint32_t) seed,    k1 = (std::uint32_t) (seed >> 32);
+
+    for (int r = 0; r < kRounds; r++)
+    {
+        std::uint64_t p0 = (std::uint64_t) kMul0 * x0;
+        std::uint64_t p1 = (std::uint64_t) kMul1 * x2;
+        x0 = (std::uint32_t) (p1 >> 32) ^ x1 ^ k0;
+        x1 = (std::uint32_t) p1;
+        x2 = (std::uint32_t) (p0 >> 32) ^ x3 ^ k1;
+        x3 = (std::uint32_t) p0;
+        k0 += kWeyl0;
+        k1 += kWeyl1;
+    }
+    out[0] = x0; out[1] = x1; out[2] = x2; out[3] = x3;
+}
+
+std::uint32_t RandomStream::next()
+{
+    if (m_used == 4)
+    {
+        block(m_seed, m_stream, m_counter++, m_buffer);
+        m_used = 0;
+    }
+    return m_buffer[m_used++];
+}
+
+float RandomStream::uniform()
+{
+    return toUnit(next());
+}
+
+float RandomStream::uniform(float lo, float hi)
+{
+    return lo + (hi - lo)*uniform();
+}
+
+void RandomStream::fillUniform(float* out, int count, float lo, float hi)
+{
+    int k = 0;
+    while (k < count && m_used < 4)
+        out[k++] = uniform(lo, hi);
+
+#ifdef RANDOM_STREAM_AVX2
+    if (hasAvx2())
+    {
+        for (; k + 32 <= count; k += 32)
+        {
+            philox8AVX(m_seed, m_stream, m_counter, lo, hi - lo, out + k);
+            m_counter += 8;
+        }
+    }
+#endif
+#ifdef RANDOM_STREAM_SSE2
+    for (; k + 16 <= count; k += 16)
+    {
+        philox4SSE(m_seed, m_stream, m_counter, lo, hi - lo, out + k);
+        m_counter += 4;
+    }
+#endif
+
+    for (; k < count; k++)
+        out[k] = uniform(lo, hi);
+}
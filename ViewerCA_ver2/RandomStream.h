@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3", SC 2011).
+//
+// Block k of stream s of a seed is 4 random words computed from (k, s) with
+// the seed as the key, no state involved; a RandomStream only keeps the seed,
+// its stream number and the next k. Streams are therefore free to create
+// (one per thread, per emitter or per task, on the stack) and never share
+// anything, so parallel code needs no locks, and the numbers only depend on
+// (seed, stream, position): the same seed reproduces a run bit for bit,
+// whatever the number of threads.
+//
+// fillUniform() computes 4 blocks at a time with SSE2, 8 with AVX2 where
+// the CPU has it, and gives the same values as as many uniform() calls.
+class RandomStream
+{
+public:
+    explicit RandomStream(std::uint64_t seed = 0, std::uint64_t stream = 0);
+
+    // 32 random bits
+    std::uint32_t next();
+    // in [0, 1), 24 random bits
+    float uniform();
+    // in [lo, hi)
+    float uniform(float lo, float hi);
+
+    // out[0 .. count) uniform in [lo, hi)
+    void fillUniform(float* out, int count, float lo, float hi);
+
+    // block of stream of seed
+    static void block(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter, std::uint32_t out[4]);
+
+private:
+    std::uint64_t m_seed;
+    std::uint64_t m_stream;
+    std::uint64_t m_counter; // next block
+    std::uint32_t m_buffer[4];
+    int m_used;              // words of m_buffer already handed out
+};
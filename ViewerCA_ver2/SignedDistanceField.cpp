@@ -0,0 +1,259 @@
+#include "SignedDistanceField.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "ThreadPool.h"
+#include "TriangleBvh.h"
+#include "mapped_file.h"
+#include "mesh_io.h"
+#include "triangle_mesh.h"
+
+
+namespace {
+
+const char kMagic[4] = { 'S', 'D', 'F', '1' };
+
+}  // namespace
+
+
+SignedDistanceField::SignedDistanceField() :
+m_resolution(0), m_nx(0), m_ny(0), m_nz(0), m_origin(0.0f), m_cellSize(0.0f), m_meshMin(0.0f), m_meshMax(0.0f),
+m_sourceHash(0)
+{
+}
+
+void SignedDistanceField::bake(const data_representation::TriangleMesh& mesh, int resolution, ThreadPool* pool)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<glm::vec3> vertices(mesh.vertices_.size() / 3);
+    m_meshMin = glm::vec3(inf);
+    m_meshMax = glm::vec3(-inf);
+    for (size_t k = 0; k < vertices.size(); k++)
+    {
+        vertices[k] = glm::vec3(mesh.vertices_[3*k], mesh.vertices_[3*k + 1], mesh.vertices_[3*k + 2]);
+        m_meshMin = glm::min(m_meshMin, vertices[k]);
+        m_meshMax = glm::max(m_meshMax, vertices[k]);
+    }
+
+    m_resolution = std::max(1, resolution);
+    m_sourceHash = 0;
+    m_distance.clear();
+    m_nx = m_ny = m_nz = 0;
+
+    glm::vec3 size = m_meshMax - m_meshMin;
+    float longest = std::max(size.x, std::max(size.y, size.z));
+    if (vertices.empty() || !(longest > 0.0f)) return;
+
+    m_cellSize = longest / m_resolution;
+    m_origin = m_meshMin - (float) kPadding * m_cellSize;
+    m_nx = (int) std::ceil(size.x / m_cellSize) + 1 + 2*kPadding;
+    m_ny = (int) std::ceil(size.y / m_cellSize) + 1 + 2*kPadding;
+    m_nz = (int) std::ceil(size.z / m_cellSize) + 1 + 2*kPadding;
+    m_distance.resize((size_t) m_nx * m_ny * m_nz);
+
+    TriangleBvh bvh;
+    bvh.build(vertices, mesh.faces_);
+
+    // slightly off the axes, so that the rays do not run along the faces
+    // and edges of axis-aligned models; long enough to leave the grid
+    const float reach = 2.0f * glm::length(glm::vec3(m_nx, m_ny, m_nz)) * m_cellSize;
+    const glm::vec3 rays[3] = { reach * glm::normalize(glm::vec3(1.0f, 0.0137f, 0.0291f)),
+                                reach * glm::normalize(glm::vec3(0.0213f, 1.0f, 0.0107f)),
+                                reach * glm::normalize(glm::vec3(0.0171f, 0.0239f, 1.0f)) };
+
+    auto bakeRange = [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            int x = i % m_nx, y = (i / m_nx) % m_ny, z = i / (m_nx * m_ny);
+            glm::vec3 p = m_origin + m_cellSize * glm::vec3(x, y, z);
+
+            int inside = 0;
+            for (const glm::vec3& ray : rays)
+                inside += bvh.countCrossings(p, p + ray) & 1;
+
+            float d = bvh.distance(p, inf);
+            m_distance[i] = inside >= 2 ? -d : d;
+        }
+    };
+
+    const int total = (int) m_distance.size();
+    if (pool)
+        pool->parallelFor(0, total, 1024, bakeRange);
+    else
+        bakeRange(0, total);
+}
+
+std::string SignedDistanceField::getCacheFileName(const std::string& plyFile)
+{
+    size_t slash = plyFile.find_last_of("/\\");
+    size_t dot = plyFile.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return plyFile + ".sdf";
+    return plyFile.substr(0, dot) + ".sdf";
+}
+
+bool SignedDistanceField::loadOrBake(const std::string& plyFile, int resolution, ThreadPool* pool, bool* fromCache)
+{
+    if (fromCache) *fromCache = false;
+
+    std::uint64_t hash;
+    if (!data_representation::HashFile(plyFile, &hash)) return false;
+
+    const std::string cacheFile = getCacheFileName(plyFile);
+    SignedDistanceField cached;
+    if (cached.load(cacheFile) && cached.m_sourceHash == hash && cached.m_resolution == std::max(1, resolution))
+    {
+        *this = std::move(cached);
+        if (fromCache) *fromCache = true;
+        return true;
+    }
+
+    data_representation::TriangleMesh mesh;
+    if (!data_representation::ReadFromPly(plyFile, &mesh)) return false;
+    bake(mesh, resolution, pool);
+    m_sourceHash = hash;
+    save(cacheFile);
+    return true;
+}
+
+bool SignedDistanceField::save(const std::string& filename) const
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file) return false;
+
+    std::int32_t header[4] = { m_resolution, m_nx, m_ny, m_nz };
+    float box[10] = { m_origin.x, m_origin.y, m_origin.z, m_cellSize,
+                      m_meshMin.x, m_meshMin.y, m_meshMin.z, m_meshMax.x, m_meshMax.y, m_meshMax.z };
+    bool ok = fwrite(kMagic, sizeof(kMagic), 1, file) == 1 &&
+              fwrite(&m_sourceHash, sizeof(m_sourceHash), 1, file) == 1 &&
+              fwrite(header, sizeof(header), 1, file) == 1 &&
+              fwrite(box, sizeof(box), 1, file) == 1 &&
+              fwrite(m_distance.data(), sizeof(float), m_distance.size(), file) == m_distance.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) remove(filename.c_str());
+    return ok;
+}
+
+bool SignedDistanceField::load(const std::string& filename)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) return false;
+
+    char magic[4];
+    std::uint64_t hash;
+    std::int32_t header[4];
+    float box[10];
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, kMagic, sizeof(kMagic)) == 0 &&
+              fread(&hash, sizeof(hash), 1, file) == 1 &&
+              fread(header, sizeof(header), 1, file) == 1 &&
+              fread(box, sizeof(box), 1, file) == 1 &&
+              header[1] >= 2 && header[2] >= 2 && header[3] >= 2 &&
+              std::isfinite(box[3]) && box[3] > 0.0f;
+
+    // The grid must be exactly what the rest of the file holds: a corrupt or
+    // truncated cache is rebaked, not trusted with an allocation.
+    if (ok)
+    {
+        long data = ftell(file);
+        ok = data >= 0 && fseek(file, 0, SEEK_END) == 0;
+        long end = ok ? ftell(file) : -1;
+        ok = ok && end >= data && (end - data) % sizeof(float) == 0 && fseek(file, data, SEEK_SET) == 0;
+        size_t values = ok ? (size_t) (end - data) / sizeof(float) : 0;
+        ok = ok && values % header[1] == 0 && values / header[1] % header[2] == 0 &&
+             values / header[1] / header[2] == (size_t) header[3];
+    }
+
+    std::vector<float> distance;
+    if (ok)
+    {
+        distance.resize((size_t) header[1] * header[2] * header[3]);
+        ok = fread(distance.data(), sizeof(float), distance.size(), file) == distance.size();
+    }
+    fclose(file);
+    if (!ok) return false;
+
+    m_sourceHash = hash;
+    m_resolution = header[0];
+    m_nx = header[1]; m_ny = header[2]; m_nz = header[3];
+    m_origin = glm::vec3(box[0], box[1], box[2]);
+    m_cellSize = box[3];
+    m_meshMin = glm::vec3(box[4], box[5], box[6]);
+    m_meshMax = glm::vec3(box[7], box[8], box[9]);
+    m_distance.swap(distance);
+    return true;
+}
+
+float SignedDistanceField::at(int x, int y, int z) const
+{
+    return m_distance[((size_t) z * m_ny + y) * m_nx + x];
+}
+
+bool SignedDistanceField::sample(const glm::vec3& p, float* distance, glm::vec3* gradient) const
+{
+    if (m_distance.empty()) return false;
+    glm::vec3 g = (p - m_origin) / m_cellSize;
+    if (!(g.x >= 0.0f && g.y >= 0.0f && g.z >= 0.0f &&
+          g.x <= m_nx - 1 && g.y <= m_ny - 1 && g.z <= m_nz - 1)) return false;
+
+    int x = std::min((int) g.x, m_nx - 2);
+    int y = std::min((int) g.y, m_ny - 2);
+    int z = std::min((int) g.z, m_nz - 2);
+    float fx = g.x - x, fy = g.y - y, fz = g.z - z;
+
+    float c000 = at(x, y, z),         c100 = at(x + 1, y, z);
+    float c010 = at(x, y + 1, z),     c110 = at(x + 1, y + 1, z);
+    float c001 = at(x, y, z + 1),     c101 = at(x + 1, y, z + 1);
+    float c011 = at(x, y + 1, z + 1), c111 = at(x + 1, y + 1, z + 1);
+
+    // along x, then y, then z
+    float c00 = c000 + fx*(c100 - c000), c10 = c010 + fx*(c110 - c010);
+    float c01 = c001 + fx*(c101 - c001), c11 = c011 + fx*(c111 - c011);
+    float c0 = c00 + fy*(c10 - c00), c1 = c01 + fy*(c11 - c01);
+    *distance = c0 + fz*(c1 - c0);
+
+    if (gradient)
+    {
+        float dx0 = (c100 - c000) + fy*((c110 - c010) - (c100 - c000));
+        float dx1 = (c101 - c001) + fy*((c111 - c011) - (c101 - c001));
+        float dy0 = c10 - c00, dy1 = c11 - c01;
+        *gradient = glm::vec3(dx0 + fz*(dx1 - dx0), dy0 + fz*(dy1 - dy0), c1 - c0) / m_cellSize;
+    }
+    return true;
+}
+
+bool SignedDistanceField::isEmpty() const
+{
+    return m_distance.empty();
+}
+
+int SignedDistanceField::getResolution() const
+{
+    return m_resolution;
+}
+
+float SignedDistanceField::getCellSize() const
+{
+    return m_cellSize;
+}
+
+glm::vec3 SignedDistanceField::getMin() const
+{
+    return m_origin;
+}
+
+glm::vec3 SignedDistanceField::getMax() const
+{
+    return m_origin + m_cellSize * glm::vec3(m_nx - 1, m_ny - 1, m_nz - 1);
+}
+
+glm::vec3 SignedDistanceField::getMeshMin() const
+{
+    return m_meshMin;
+}
+
+glm::vec3 SignedDistanceField::getMeshMax() const
+{
+    return m_meshMax;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#ifdef WIN32
+	#include <glm\glm.hpp>
+#else
+	#include <glm/glm.hpp>
+#endif
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+namespace data_representation {
+class TriangleMesh;
+}  // namespace data_representation
+
+// Signed distance to a closed triangle mesh, sampled on a regular grid in
+// the coordinates of the mesh (negative inside).
+//
+// bake() puts resolution cells along the longest side of the mesh box, plus
+// kPadding cells on every side, and at each grid point takes the distance
+// to the nearest triangle and the inside/outside parity of three rays
+// (majority, so a ray through an edge or a hole does not flip the sign);
+// both queries go through a TriangleBvh and the grid points split across
+// the thread pool. A query is then a trilinear sample of the 8 corners of
+// one cell and the gradient of that interpolant, whatever the number of
+// triangles.
+//
+// loadOrBake() keeps the bake next to the model (teapot.ply -> teapot.sdf),
+// tagged with a hash of the PLY file and the resolution, and only bakes
+// again when either changes.
+class SignedDistanceField
+{
+public:
+    SignedDistanceField();
+
+    void bake(const data_representation::TriangleMesh& mesh, int resolution, ThreadPool* pool);
+
+    // the cache of plyFile if it matches, else ReadFromPly + bake() + save();
+    // pool may be null (serial). False if neither the cache nor the model
+    // could be read; failing to write the cache is not an error.
+    bool loadOrBake(const std::string& plyFile, int resolution, ThreadPool* pool, bool* fromCache = nullptr);
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+    static std::string getCacheFileName(const std::string& plyFile);
+
+    // distance and gradient (not normalized) at p; false outside the grid,
+    // where the mesh is farther than kPadding cells
+    bool sample(const glm::vec3& p, float* distance, glm::vec3* gradient) const;
+
+    bool isEmpty() const;
+    int getResolution() const;
+    float getCellSize() const;
+    // grid box
+    glm::vec3 getMin() const;
+    glm::vec3 getMax() const;
+    // box of the mesh it was baked from
+    glm::vec3 getMeshMin() const;
+    glm::vec3 getMeshMax() const;
+
+    static const int kPadding = 2;
+
+private:
+    float at(int x, int y, int z) const;
+
+    int m_resolution;
+    int m_nx, m_ny, m_nz;      // grid points along each axis
+    glm::vec3 m_origin;        // grid point (0, 0, 0)
+    float m_cellSize;
+    glm::vec3 m_meshMin, m_meshMax;
+    std::uint64_t m_sourceHash; // of the PLY file, 0 if baked from memory
+    std::vector<float> m_distance; // x fastest
+};
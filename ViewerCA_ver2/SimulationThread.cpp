@@ -0,0 +1,115 @@
+#include "SimulationThread.h"
+#include <chrono>
+
+
+SimulationThread::SimulationThread(ParticleSystem& ps, float stepDt, int stepsPerSecond, int maxSubsteps) :
+m_ps(ps), m_stepDt(stepDt), m_stepsPerSecond(stepsPerSecond > 0 ? stepsPerSecond : 60),
+m_maxSubsteps(maxSubsteps > 0 ? maxSubsteps : 1), m_method(Particle::UpdateMethod::EulerOrig), m_adaptive(false),
+m_running(false), m_back(0), m_front(1), m_middle(2), m_step(0), m_simTime(0.0)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start()
+{
+    if (m_running) return;
+    m_running = true;
+    publish(); // so the renderer has something before the first step
+    m_thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop()
+{
+    m_running = false;
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void SimulationThread::post(Command command)
+{
+    std::lock_guard<std::mutex> lock(m_commandMutex);
+    m_commands.push_back(std::move(command));
+}
+
+void SimulationThread::setMethod(Particle::UpdateMethod method)
+{
+    post([this, method](ParticleSystem&) { m_method = method; });
+}
+
+void SimulationThread::setAdaptive(bool adaptive)
+{
+    post([this, adaptive](ParticleSystem&) { m_adaptive = adaptive; });
+}
+
+bool SimulationThread::runCommands()
+{
+    std::vector<Command> commands;
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        commands.swap(m_commands);
+    }
+    for (Command& c : commands)
+        c(m_ps);
+    return !commands.empty();
+}
+
+void SimulationThread::publish()
+{
+    SimulationSnapshot& snap = m_buffers[m_back];
+    snap.numParticles = m_ps.getNumParticles();
+    snap.positions.resize(3 * (size_t) snap.numParticles);
+    m_ps.copyPositions(snap.positions.data());
+    snap.step = m_step;
+    snap.simTime = m_simTime;
+    snap.timings = m_ps.takeStepTimings();
+
+    m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & ~kFresh;
+}
+
+const SimulationSnapshot& SimulationThread::acquireSnapshot()
+{
+    if (m_middle.load(std::memory_order_acquire) & kFresh)
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~kFresh;
+    return m_buffers[m_front];
+}
+
+void SimulationThread::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration stepWall = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(1.0 / m_stepsPerSecond));
+
+    Clock::time_point previous = Clock::now();
+    Clock::duration accumulator(0);
+
+    while (m_running)
+    {
+        Clock::time_point now = Clock::now();
+        accumulator += now - previous;
+        previous = now;
+
+        bool changed = runCommands();
+
+        int substeps = 0;
+        while (accumulator >= stepWall && substeps < m_maxSubsteps)
+        {
+            if (m_adaptive)
+                m_ps.advance(m_stepDt, m_method);
+            else
+                m_ps.updateParticleSystem(m_stepDt, m_method);
+            accumulator -= stepWall;
+            m_simTime += m_stepDt;
+            ++m_step;
+            ++substeps;
+        }
+        // fell behind: drop the backlog instead of trying to catch up forever
+        if (substeps == m_maxSubsteps) accumulator = Clock::duration(0);
+
+        if (substeps > 0 || changed) publish();
+
+        std::this_thread::sleep_for(stepWall - accumulator);
+    }
+}
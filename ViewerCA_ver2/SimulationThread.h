@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ParticleSystem.h"
+
+// Positions of every particle after some simulation step.
+struct SimulationSnapshot
+{
+    std::vector<float> positions; // x,y,z interleaved, 3*numParticles floats
+    int    numParticles = 0;
+    long   step = 0;
+    double simTime = 0.0;
+    StepTimings timings; // steps since the previous snapshot (PARTICLES_PROFILE builds)
+};
+
+// Runs a ParticleSystem on its own thread with a fixed timestep.
+//
+// Wall-clock time is accumulated and consumed in fixed steps of
+// 1/stepsPerSecond seconds, each advancing the simulation by stepDt, with at
+// most maxSubsteps steps per wake-up (the rest is dropped, so a stall does not
+// snowball). Rendering speed therefore no longer changes the physics. With
+// setAdaptive(true) each of those steps is a ParticleSystem::advance(), which
+// splits stepDt into as many substeps as the scene needs.
+//
+// After each batch of steps the positions are published through a lock-free
+// triple buffer: the simulation owns a back buffer, the renderer a front
+// buffer, and the third one is swapped between them with a single atomic
+// exchange, so neither side ever waits for the other.
+//
+// Everything that touches the ParticleSystem from another thread (UI setters,
+// resets) must go through post(); commands run on the simulation thread
+// before the next step.
+class SimulationThread
+{
+public:
+    typedef std::function<void(ParticleSystem&)> Command;
+
+    SimulationThread(ParticleSystem& ps, float stepDt = 0.1f, int stepsPerSecond = 60, int maxSubsteps = 8);
+    ~SimulationThread();
+
+    void start();
+    void stop();
+
+    void post(Command command);
+    void setMethod(Particle::UpdateMethod method);
+    void setAdaptive(bool adaptive);
+
+    // Latest published snapshot; stays valid until the next call. Renderer thread only.
+    const SimulationSnapshot& acquireSnapshot();
+
+private:
+    void run();
+    bool runCommands(); // true if any command ran
+    void publish();
+
+    ParticleSystem& m_ps;
+    float m_stepDt;
+    int   m_stepsPerSecond;
+    int   m_maxSubsteps;
+    Particle::UpdateMethod m_method; // simulation thread only
+    bool m_adaptive;                 // simulation thread only
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+
+    std::mutex m_commandMutex;
+    std::vector<Command> m_commands;
+
+    // triple buffer; m_middle holds an index plus kFresh when it has unread data
+    static const int kFresh = 4;
+    SimulationSnapshot m_buffers[3];
+    int m_back;                 // simulation thread only
+    int m_front;                // renderer thread only
+    std::atomic<int> m_middle;
+
+    long   m_step;
+    double m_simTime;
+};
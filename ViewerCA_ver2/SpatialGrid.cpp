@@ -0,0 +1,71 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+
+
+SpatialGrid::SpatialGrid() : m_cellSize(1.0f), m_invCellSize(1.0f), m_tableMask(0)
+{
+}
+
+void SpatialGrid::setCellSize(float cellSize)
+{
+    m_cellSize = std::max(cellSize, 1e-6f);
+    m_invCellSize = 1.0f / m_cellSize;
+}
+
+float SpatialGrid::getCellSize() const
+{
+    return m_cellSize;
+}
+
+void SpatialGrid::build(const Vec3Array& position, int numParticles, const std::uint8_t* include)
+{
+    // ~2 buckets per particle keeps collisions rare; power of two for masking
+    std::uint32_t tableSize = 64;
+    while (tableSize < 2u * (std::uint32_t) numParticles) tableSize <<= 1;
+    m_tableMask = tableSize - 1;
+
+    m_cellStart.assign(tableSize + 1, 0);
+    m_particleHash.resize(numParticles);
+    m_particleKey.resize(numParticles);
+
+    // count
+    const std::uint32_t kExcluded = 0xffffffffu;
+    for (int i = 0; i < numParticles; i++)
+    {
+        // a blown-up (NaN/inf) particle would land in one cell with all the others
+        glm::vec3 p = position.get(i);
+        if ((include != nullptr && !include[i]) || !std::isfinite(p.x + p.y + p.z))
+        {
+            m_particleHash[i] = kExcluded;
+            continue;
+        }
+        glm::ivec3 c = cellOf(p);
+        std::uint32_t h = hashCell(c.x, c.y, c.z);
+        m_particleHash[i] = h;
+        m_particleKey[i] = cellKey(c.x, c.y, c.z);
+        m_cellStart[h + 1]++;
+    }
+
+    // prefix sum
+    for (std::uint32_t h = 0; h < tableSize; h++)
+        m_cellStart[h + 1] += m_cellStart[h];
+
+    // scatter (stable, so particles stay sorted by index inside a cell)
+    m_sortedIndex.resize(m_cellStart[tableSize]);
+    m_sortedKey.resize(m_cellStart[tableSize]);
+    m_cursor.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (int i = 0; i < numParticles; i++)
+    {
+        std::uint32_t h = m_particleHash[i];
+        if (h == kExcluded) continue;
+        int s = m_cursor[h]++;
+        m_sortedIndex[s] = i;
+        m_sortedKey[s] = m_particleKey[i];
+    }
+}
+
+void SpatialGrid::queryNeighbors(const Vec3Array& position, glm::vec3 p, float radius, std::vector<int>& out) const
+{
+    forEachNeighbor(position, p, radius, [&out](int j) { out.push_back(j); });
+}
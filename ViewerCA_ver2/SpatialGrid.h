@@ -0,0 +1,115 @@
+#pragma once
+#ifdef WIN32
+	#include <glm\glm.hpp>
+#else
+	#include <glm/glm.hpp>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "ParticleStore.h"
+
+// Uniform grid over an unbounded domain, stored as a hash table of cells.
+//
+// build() is a counting sort of the particles by cell hash: one pass to
+// count, a prefix sum, one pass to scatter. Afterwards the particles of a
+// cell are contiguous in sortedIndex, so a neighbor query within one cell
+// size visits 27 cells and costs O(particles nearby), and the whole build is
+// O(N). Larger radii walk ceil(radius / cell size) cells each way.
+// Cells whose hashes collide share a bucket; each entry keeps the key of its
+// own cell, so a query skips the entries of other cells without touching
+// their positions.
+class SpatialGrid
+{
+public:
+    SpatialGrid();
+
+    // queries up to this radius walk 3x3x3 cells
+    void setCellSize(float cellSize);
+    float getCellSize() const;
+
+    // particles with include[i] == 0 (include may be null) or a non-finite
+    // position are left out
+    void build(const Vec3Array& position, int numParticles, const std::uint8_t* include = nullptr);
+
+    // calls fn(j) for every particle j within radius of p; past one cell
+    // size, once the cells to walk outnumber the particles, all of them are
+    // tested instead
+    template <class Fn>
+    void forEachNeighbor(const Vec3Array& position, glm::vec3 p, float radius, Fn fn) const;
+
+    // indices of the particles within radius of p, appended to out
+    void queryNeighbors(const Vec3Array& position, glm::vec3 p, float radius, std::vector<int>& out) const;
+
+private:
+    glm::ivec3 cellOf(glm::vec3 p) const;
+    std::uint32_t hashCell(int x, int y, int z) const;
+    static std::uint64_t cellKey(int x, int y, int z);
+
+    float m_cellSize;
+    float m_invCellSize;
+    std::uint32_t m_tableMask;
+
+    std::vector<int> m_cellStart;      // tableSize + 1 offsets into m_sortedIndex
+    std::vector<int> m_sortedIndex;    // particle ids, grouped by cell hash
+    std::vector<std::uint64_t> m_sortedKey; // cellKey of each m_sortedIndex entry
+    std::vector<std::uint32_t> m_particleHash;
+    std::vector<std::uint64_t> m_particleKey;
+    std::vector<int> m_cursor;         // scatter scratch
+};
+
+
+inline glm::ivec3 SpatialGrid::cellOf(glm::vec3 p) const
+{
+    return glm::ivec3((int) floorf(p.x * m_invCellSize), (int) floorf(p.y * m_invCellSize), (int) floorf(p.z * m_invCellSize));
+}
+
+inline std::uint32_t SpatialGrid::hashCell(int x, int y, int z) const
+{
+    return ((std::uint32_t) x * 73856093u ^ (std::uint32_t) y * 19349663u ^ (std::uint32_t) z * 83492791u) & m_tableMask;
+}
+
+// 21 bits per axis: unique among any block of cells narrower than 2^21
+inline std::uint64_t SpatialGrid::cellKey(int x, int y, int z)
+{
+    const std::uint64_t m = 0x1fffff;
+    return (((std::uint64_t) x & m) << 42) | (((std::uint64_t) y & m) << 21) | ((std::uint64_t) z & m);
+}
+
+template <class Fn>
+void SpatialGrid::forEachNeighbor(const Vec3Array& position, glm::vec3 p, float radius, Fn fn) const
+{
+    if (m_cellStart.empty()) return;
+
+    const float r2 = radius * radius;
+    const float reach = std::max(1.0f, std::ceil(radius * m_invCellSize));
+    const float side = 2.0f * reach + 1.0f;
+    if (reach > 1.0f && !(side * side * side <= (float) m_sortedIndex.size()))
+    {
+        for (int j : m_sortedIndex)
+        {
+            glm::vec3 d = position.get(j) - p;
+            if (glm::dot(d, d) <= r2) fn(j);
+        }
+        return;
+    }
+
+    const glm::ivec3 c = cellOf(p);
+    const int r = (int) reach;
+    for (int dz = -r; dz <= r; dz++)
+    for (int dy = -r; dy <= r; dy++)
+    for (int dx = -r; dx <= r; dx++)
+    {
+        const std::uint32_t h = hashCell(c.x + dx, c.y + dy, c.z + dz);
+        const std::uint64_t key = cellKey(c.x + dx, c.y + dy, c.z + dz);
+
+        for (int s = m_cellStart[h]; s < m_cellStart[h + 1]; s++)
+        {
+            if (m_sortedKey[s] != key) continue; // another cell in the same bucket
+            int j = m_sortedIndex[s];
+            glm::vec3 d = position.get(j) - p;
+            if (glm::dot(d, d) <= r2) fn(j);
+        }
+    }
+}
@@ -0,0 +1,324 @@
+#include "SpringNetwork.h"
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+int lowestSetBit(std::uint64_t x)
+{
+    int bit = 0;
+    while (!(x & 1)) { x >>= 1; bit++; }
+    return bit;
+}
+
+}  // namespace
+
+
+SpringNetwork::SpringNetwork() : m_topologyVersion(0), m_coefficientVersion(0), m_coloringVersion(-1)
+{
+    m_adjStart.assign(1, 0);
+    m_colorStart.assign(1, 0);
+}
+
+void SpringNetwork::clear()
+{
+    a.clear();
+    b.clear();
+    restLength.clear();
+    stiffness.clear();
+    damping.clear();
+    type.clear();
+    m_adjStart.assign(1, 0);
+    m_adjSpring.clear();
+    m_adjSign.clear();
+    m_colorStart.assign(1, 0);
+    m_coloredSprings.clear();
+    m_topologyVersion++;
+}
+
+int SpringNetwork::addSpring(int pa, int pb, float rest, const SpringCoefficients& k, SpringType springType)
+{
+    a.push_back(pa);
+    b.push_back(pb);
+    restLength.push_back(rest);
+    stiffness.push_back(k.stiffness);
+    damping.push_back(k.damping);
+    type.push_back(springType);
+    return (int) a.size() - 1;
+}
+
+void SpringNetwork::addLattice(int first, int nx, int ny, int nz, int numParticles, float spacing,
+                               const SpringCoefficients& structural, const SpringCoefficients& shear,
+                               const SpringCoefficients& bending)
+{
+    // Every neighbor offset that points "forward" (first nonzero of dz, dy,
+    // dx positive), so each pair is visited once. Axis neighbors go first, so
+    // a rope's spring i joins particles i and i+1.
+    struct Offset { int dx, dy, dz; SpringType type; };
+    std::vector<Offset> offsets = { { 1, 0, 0, SpringType::Structural },
+                                    { 0, 1, 0, SpringType::Structural },
+                                    { 0, 0, 1, SpringType::Structural } };
+    for (int dz = 0; dz <= 1; dz++)
+    for (int dy = -1; dy <= 1; dy++)
+    for (int dx = -1; dx <= 1; dx++)
+    {
+        bool forward = dz > 0 || dy > 0 || (dy == 0 && dx > 0);
+        int axes = (dx != 0) + (dy != 0) + (dz != 0);
+        if (forward && axes >= 2) offsets.push_back({ dx, dy, dz, SpringType::Shear });
+    }
+    offsets.push_back({ 2, 0, 0, SpringType::Bending });
+    offsets.push_back({ 0, 2, 0, SpringType::Bending });
+    offsets.push_back({ 0, 0, 2, SpringType::Bending });
+
+    auto index = [&](int x, int y, int z) { return first + x + nx*(y + ny*z); };
+
+    for (int z = 0; z < nz; z++)
+    for (int y = 0; y < ny; y++)
+    for (int x = 0; x < nx; x++)
+    {
+        int i = index(x, y, z);
+        if (i >= numParticles) return;
+
+        for (const Offset& o : offsets)
+        {
+            const SpringCoefficients& k = o.type == SpringType::Structural ? structural :
+                                          o.type == SpringType::Shear      ? shear : bending;
+            if (k.stiffness == 0.0f && k.damping == 0.0f) continue;
+
+            int x2 = x + o.dx, y2 = y + o.dy, z2 = z + o.dz;
+            if (x2 < 0 || x2 >= nx || y2 < 0 || y2 >= ny || z2 >= nz) continue;
+            int j = index(x2, y2, z2);
+            if (j >= numParticles) continue;
+
+            float rest = spacing * std::sqrt((float) (o.dx*o.dx + o.dy*o.dy + o.dz*o.dz));
+            addSpring(i, j, rest, k, o.type);
+        }
+    }
+}
+
+void SpringNetwork::buildAdjacency(int numParticles)
+{
+    const int numSprings = getNumSprings();
+
+    // counting sort of the (particle, spring) pairs by particle; springs are
+    // visited in order, so each particle's list comes out sorted
+    m_adjStart.assign(numParticles + 1, 0);
+    for (int s = 0; s < numSprings; s++)
+    {
+        m_adjStart[a[s] + 1]++;
+        m_adjStart[b[s] + 1]++;
+    }
+    for (int i = 0; i < numParticles; i++)
+        m_adjStart[i + 1] += m_adjStart[i];
+
+    m_adjSpring.resize(2 * (size_t) numSprings);
+    m_adjSign.resize(2 * (size_t) numSprings);
+    m_cursor.assign(m_adjStart.begin(), m_adjStart.end() - 1);
+    for (int s = 0; s < numSprings; s++)
+    {
+        int ka = m_cursor[a[s]]++;
+        m_adjSpring[ka] = s;
+        m_adjSign[ka] = 1.0f;
+
+        int kb = m_cursor[b[s]]++;
+        m_adjSpring[kb] = s;
+        m_adjSign[kb] = -1.0f;
+    }
+
+    // the old coloring belongs to the previous topology
+    m_colorStart.assign(1, 0);
+    m_coloredSprings.clear();
+    m_topologyVersion++;
+}
+
+void SpringNetwork::setCoefficients(SpringType springType, const SpringCoefficients& k)
+{
+    for (int s = 0; s < getNumSprings(); s++)
+    {
+        if (type[s] != springType) continue;
+        stiffness[s] = k.stiffness;
+        damping[s] = k.damping;
+    }
+    m_coefficientVersion++;
+}
+
+void SpringNetwork::buildColoring()
+{
+    const int numParticles = (int) m_adjStart.size() - 1;
+    const int numSprings = getNumSprings();
+
+    // greedy: each spring takes the lowest color unused at both of its
+    // particles, which needs at most 2*maxDegree - 1 colors
+    int maxDegree = 0;
+    for (int i = 0; i < numParticles; i++)
+        maxDegree = std::max(maxDegree, m_adjStart[i + 1] - m_adjStart[i]);
+    const int words = (2 * maxDegree) / 64 + 1;
+
+    std::vector<std::uint64_t> used((size_t) numParticles * words, 0); // color bitmask per particle
+    std::vector<int> color(numSprings);
+    int numColors = 0;
+    for (int s = 0; s < numSprings; s++)
+    {
+        std::uint64_t* ua = &used[(size_t) a[s] * words];
+        std::uint64_t* ub = &used[(size_t) b[s] * words];
+        int c = 0;
+        for (int w = 0; w < words; w++)
+        {
+            std::uint64_t unused = ~(ua[w] | ub[w]);
+            if (unused) { c = 64 * w + lowestSetBit(unused); break; }
+        }
+        ua[c / 64] |= std::uint64_t(1) << (c % 64);
+        ub[c / 64] |= std::uint64_t(1) << (c % 64);
+        color[s] = c;
+        numColors = std::max(numColors, c + 1);
+    }
+
+    // group by color (stable counting sort)
+    m_colorStart.assign(numColors + 1, 0);
+    for (int s = 0; s < numSprings; s++)
+        m_colorStart[color[s] + 1]++;
+    for (int c = 0; c < numColors; c++)
+        m_colorStart[c + 1] += m_colorStart[c];
+    m_coloredSprings.resize(numSprings);
+    m_cursor.assign(m_colorStart.begin(), m_colorStart.end() - 1);
+    for (int s = 0; s < numSprings; s++)
+        m_coloredSprings[m_cursor[color[s]]++] = s;
+
+    m_coloringVersion = m_topologyVersion;
+}
+
+bool SpringNetwork::hasColoring() const
+{
+    return m_coloringVersion == m_topologyVersion;
+}
+
+int SpringNetwork::getNumSprings() const
+{
+    return (int) a.size();
+}
+
+int SpringNetwork::getTopologyVersion() const
+{
+    return m_topologyVersion;
+}
+
+int SpringNetwork::getCoefficientVersion() const
+{
+    return m_coefficientVersion;
+}
+
+const std::vector<int>& SpringNetwork::getAdjacencyStart() const
+{
+    return m_adjStart;
+}
+
+const std::vector<int>& SpringNetwork::getAdjacentSprings() const
+{
+    return m_adjSpring;
+}
+
+int SpringNetwork::getNumColors() const
+{
+    return (int) m_colorStart.size() - 1;
+}
+
+const std::vector<int>& SpringNetwork::getColorStart() const
+{
+    return m_colorStart;
+}
+
+const std::vector<int>& SpringNetwork::getColoredSprings() const
+{
+    return m_coloredSprings;
+}
+
+glm::vec3 SpringNetwork::getForce(int s, const Vec3Array& position, const Vec3Array& velocity) const
+{
+    glm::vec3 dPos = position.get(a[s]) - position.get(b[s]);
+    float     dist = glm::length(dPos);
+    if (!(dist > 0.0f)) return glm::vec3(0.0f);
+
+    glm::vec3 n = dPos / dist; // from b to a
+    float tension = stiffness[s]*(dist - restLength[s]) + damping[s]*glm::dot(velocity.get(a[s]) - velocity.get(b[s]), n);
+    return -tension * n;
+}
+
+namespace {
+
+// force[s] for the springs in [begin, end); normalVelocity(i, j, nx, ny, nz)
+// is dot(v_i - v_j, n)
+template <class NormalVelocity>
+void springForces(const SpringNetwork& springs, const Vec3Array& position, int begin, int end, Vec3Array& force,
+                  NormalVelocity normalVelocity)
+{
+    const float* px = position.x.data(); const float* py = position.y.data(); const float* pz = position.z.data();
+    const int* ia = springs.a.data();
+    const int* ib = springs.b.data();
+    const float* rest = springs.restLength.data();
+    const float* ks = springs.stiffness.data();
+    const float* kd = springs.damping.data();
+    float* fx = force.x.data(); float* fy = force.y.data(); float* fz = force.z.data();
+
+    // same operations, in the same order, as getForce
+    for (int s = begin; s < end; s++)
+    {
+        const int i = ia[s], j = ib[s];
+        float dx = px[i] - px[j], dy = py[i] - py[j], dz = pz[i] - pz[j];
+        float dist = std::sqrt(dx*dx + dy*dy + dz*dz);
+        float nx = dx / dist, ny = dy / dist, nz = dz / dist;
+
+        float vn = normalVelocity(i, j, nx, ny, nz);
+        float f = -(ks[s]*(dist - rest[s]) + kd[s]*vn);
+
+        bool apart = dist > 0.0f;
+        fx[s] = apart ? f*nx : 0.0f;
+        fy[s] = apart ? f*ny : 0.0f;
+        fz[s] = apart ? f*nz : 0.0f;
+    }
+}
+
+}  // namespace
+
+void SpringNetwork::computeForces(const Vec3Array& position, const Vec3Array& velocity, int begin, int end,
+                                  Vec3Array& force) const
+{
+    const float* vx = velocity.x.data(); const float* vy = velocity.y.data(); const float* vz = velocity.z.data();
+    springForces(*this, position, begin, end, force, [=](int i, int j, float nx, float ny, float nz) {
+        return (vx[i] - vx[j])*nx + (vy[i] - vy[j])*ny + (vz[i] - vz[j])*nz;
+    });
+}
+
+void SpringNetwork::computeForces(const Vec3Array& position, const Vec3Array& previousPosition, float invDt,
+                                  int begin, int end, Vec3Array& force) const
+{
+    const float* px = position.x.data(); const float* py = position.y.data(); const float* pz = position.z.data();
+    const float* qx = previousPosition.x.data(); const float* qy = previousPosition.y.data();
+    const float* qz = previousPosition.z.data();
+    springForces(*this, position, begin, end, force, [=](int i, int j, float nx, float ny, float nz) {
+        float vx = ((px[i] - qx[i]) - (px[j] - qx[j]))*invDt;
+        float vy = ((py[i] - qy[i]) - (py[j] - qy[j]))*invDt;
+        float vz = ((pz[i] - qz[i]) - (pz[j] - qz[j]))*invDt;
+        return vx*nx + vy*ny + vz*nz;
+    });
+}
+
+void SpringNetwork::gatherForces(const Vec3Array& force, int begin, int end, Vec3Array& total) const
+{
+    const float* fx = force.x.data(); const float* fy = force.y.data(); const float* fz = force.z.data();
+    float* tx = total.x.data(); float* ty = total.y.data(); float* tz = total.z.data();
+
+    for (int i = begin; i < end; i++)
+    {
+        float x = tx[i], y = ty[i], z = tz[i];
+        for (int k = m_adjStart[i]; k < m_adjStart[i + 1]; k++)
+        {
+            const int s = m_adjSpring[k];
+            const float sign = m_adjSign[k];
+            x += sign*fx[s];
+            y += sign*fy[s];
+            z += sign*fz[s];
+        }
+        tx[i] = x; ty[i] = y; tz[i] = z;
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#ifdef WIN32
+	#include <glm\glm.hpp>
+#else
+	#include <glm/glm.hpp>
+#endif
+#include <cstdint>
+#include <vector>
+#include "ParticleStore.h"
+
+enum class SpringType : std::int8_t { Structural, Shear, Bending };
+
+struct SpringCoefficients
+{
+    float stiffness; // >= 0, Hooke constant
+    float damping;   // >= 0, along the spring direction
+};
+
+// Damped springs between pairs of particles, each with its own rest length,
+// stiffness and damping.
+//
+// The springs are a flat edge list (one array per attribute, like
+// ParticleStore), so computing every spring force is one linear sweep. The
+// CSR adjacency built by buildAdjacency() lists, for each particle, the
+// springs it belongs to in increasing spring order; summing the forces on a
+// particle then only writes that particle, so both passes split freely
+// across threads and the result does not depend on the split.
+//
+// buildColoring() colors the springs greedily so that no two springs of the
+// same color share a particle. The springs of one color can then be updated
+// in place, in parallel, without locks (constraint solvers). The coloring is
+// only built on request and kept until the topology changes.
+//
+// Every buildAdjacency() or clear() is a new topology version; data derived
+// from the topology (coloring, solver sparsity patterns) is cached against
+// getTopologyVersion() and rebuilt only when it moves; data derived from the
+// coefficients as well is also cached against getCoefficientVersion().
+class SpringNetwork
+{
+public:
+    SpringNetwork();
+
+    void clear();
+
+    // appends a spring between particles a and b and returns its index;
+    // call buildAdjacency() once all the springs are in
+    int addSpring(int a, int b, float restLength, const SpringCoefficients& k, SpringType type = SpringType::Structural);
+
+    // Springs of an nx * ny * nz block of particles, particle (x, y, z) being
+    // first + x + nx*(y + ny*z); particles at or past numParticles are left
+    // out, so the last layer may be partial. Structural springs join axis
+    // neighbors, shear springs face and body diagonals, bending springs skip
+    // one particle along an axis. A type whose coefficients are both zero is
+    // not added. ny = nz = 1 is a rope, nz = 1 a sheet of cloth.
+    void addLattice(int first, int nx, int ny, int nz, int numParticles, float spacing,
+                    const SpringCoefficients& structural, const SpringCoefficients& shear,
+                    const SpringCoefficients& bending);
+
+    void buildAdjacency(int numParticles);
+
+    // stiffness and damping of every spring of the given type, in place
+    // (same topology, new coefficient version)
+    void setCoefficients(SpringType springType, const SpringCoefficients& k);
+
+    // colors the springs of the current topology (after buildAdjacency)
+    void buildColoring();
+    // true once buildColoring() ran for the current topology
+    bool hasColoring() const;
+
+    int getNumSprings() const;
+    int getTopologyVersion() const;
+    int getCoefficientVersion() const;
+
+    // CSR adjacency: the springs of particle i are
+    // getAdjacentSprings()[getAdjacencyStart()[i] .. getAdjacencyStart()[i + 1])
+    const std::vector<int>& getAdjacencyStart() const;
+    const std::vector<int>& getAdjacentSprings() const;
+
+    // springs of color c are getColoredSprings()[getColorStart()[c] .. getColorStart()[c + 1]),
+    // in increasing order; empty until buildColoring()
+    int getNumColors() const;
+    const std::vector<int>& getColorStart() const;
+    const std::vector<int>& getColoredSprings() const;
+
+    // force of spring s on its endpoint a (endpoint b gets the opposite)
+    glm::vec3 getForce(int s, const Vec3Array& position, const Vec3Array& velocity) const;
+
+    // force[s] = getForce(s) for the springs in [begin, end); force must hold getNumSprings()
+    void computeForces(const Vec3Array& position, const Vec3Array& velocity, int begin, int end, Vec3Array& force) const;
+    // same, with the velocities derived from the positions: (position - previousPosition)*invDt (Verlet)
+    void computeForces(const Vec3Array& position, const Vec3Array& previousPosition, float invDt,
+                       int begin, int end, Vec3Array& force) const;
+
+    // total[i] += the forces of the springs of particle i, for i in [begin, end)
+    void gatherForces(const Vec3Array& force, int begin, int end, Vec3Array& total) const;
+
+    // edge list, one entry per spring
+    std::vector<int>        a;
+    std::vector<int>        b;
+    std::vector<float>      restLength;
+    std::vector<float>      stiffness;
+    std::vector<float>      damping;
+    std::vector<SpringType> type;
+
+private:
+    std::vector<int>   m_adjStart;  // numParticles + 1 offsets into m_adjSpring
+    std::vector<int>   m_adjSpring; // springs of each particle, in increasing order
+    std::vector<float> m_adjSign;   // +1 if the particle is endpoint a, -1 if b
+    std::vector<int>   m_cursor;    // scatter scratch
+
+    std::vector<int>   m_colorStart; // numColors + 1 offsets into m_coloredSprings
+    std::vector<int>   m_coloredSprings;
+
+    int m_topologyVersion;
+    int m_coefficientVersion;
+    int m_coloringVersion; // topology the coloring was built for, -1 if none
+};
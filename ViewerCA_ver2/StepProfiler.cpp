@@ -0,0 +1,54 @@
+#include "StepProfiler.h"
+
+
+const char* stepPhaseName(StepPhase phase)
+{
+    switch (phase)
+    {
+    case StepPhase::Forces:              return "forces";
+    case StepPhase::Springs:             return "springs";
+    case StepPhase::ImplicitSolve:       return "implicit solve";
+    case StepPhase::Integration:         return "integration";
+    case StepPhase::Constraints:         return "constraint solve";
+    case StepPhase::CollisionDetection:  return "collision detection";
+    case StepPhase::CollisionCorrection: return "collision correction";
+    }
+    return "?";
+}
+
+StepTimings& StepTimings::operator+=(const StepTimings& other)
+{
+    for (int p = 0; p < kNumStepPhases; p++)
+        phaseSeconds[p] += other.phaseSeconds[p];
+    stepSeconds += other.stepSeconds;
+    steps += other.steps;
+    return *this;
+}
+
+StepProfiler::StepProfiler() : m_stepNs(0), m_steps(0)
+{
+    for (std::atomic<std::int64_t>& ns : m_phaseNs)
+        ns = 0;
+}
+
+void StepProfiler::addPhase(StepPhase phase, Clock::duration elapsed)
+{
+    m_phaseNs[(int) phase].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                     std::memory_order_relaxed);
+}
+
+void StepProfiler::addStep(Clock::duration elapsed)
+{
+    m_stepNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+    m_steps.fetch_add(1, std::memory_order_relaxed);
+}
+
+StepTimings StepProfiler::take()
+{
+    StepTimings t;
+    for (int p = 0; p < kNumStepPhases; p++)
+        t.phaseSeconds[p] = m_phaseNs[p].exchange(0, std::memory_order_relaxed) * 1e-9;
+    t.stepSeconds = m_stepNs.exchange(0, std::memory_order_relaxed) * 1e-9;
+    t.steps = m_steps.exchange(0, std::memory_order_relaxed);
+    return t;
+}
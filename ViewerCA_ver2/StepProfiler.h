@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Per-phase timers for ParticleSystem::updateParticleSystem.
+//
+// Only compiled in when PARTICLES_PROFILE is defined (debug builds, or
+// CONFIG+=profile, see the .pro files). Without it PROFILE_STEP_PHASE and
+// PROFILE_STEP expand to nothing and ParticleSystem has no profiler member,
+// so release builds carry no timing code at all.
+//
+// Phases that run on the thread pool are timed per chunk and summed over the
+// workers, so with several threads a phase can add up to more than the wall
+// time of the step (stepSeconds).
+
+enum class StepPhase : std::int8_t { Forces, Springs, ImplicitSolve, Integration, Constraints, CollisionDetection, CollisionCorrection };
+const int kNumStepPhases = 7;
+
+const char* stepPhaseName(StepPhase phase);
+
+struct StepTimings
+{
+    double phaseSeconds[kNumStepPhases] = {};
+    double stepSeconds = 0.0;   // wall time of the steps
+    int    steps = 0;
+
+    double seconds(StepPhase phase) const { return phaseSeconds[(int) phase]; }
+    StepTimings& operator+=(const StepTimings& other);
+};
+
+class StepProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    StepProfiler();
+
+    // both thread safe
+    void addPhase(StepPhase phase, Clock::duration elapsed);
+    void addStep(Clock::duration elapsed);
+
+    // everything accumulated since the previous call; resets the counters
+    StepTimings take();
+
+private:
+    std::atomic<std::int64_t> m_phaseNs[kNumStepPhases];
+    std::atomic<std::int64_t> m_stepNs;
+    std::atomic<int> m_steps;
+};
+
+class ScopedPhaseTimer
+{
+public:
+    ScopedPhaseTimer(StepProfiler& profiler, StepPhase phase) :
+    m_profiler(profiler), m_phase(phase), m_start(StepProfiler::Clock::now()) {}
+    ~ScopedPhaseTimer() { m_profiler.addPhase(m_phase, StepProfiler::Clock::now() - m_start); }
+
+private:
+    StepProfiler& m_profiler;
+    StepPhase m_phase;
+    StepProfiler::Clock::time_point m_start;
+};
+
+class ScopedStepTimer
+{
+public:
+    explicit ScopedStepTimer(StepProfiler& profiler) : m_profiler(profiler), m_start(StepProfiler::Clock::now()) {}
+    ~ScopedStepTimer() { m_profiler.addStep(StepProfiler::Clock::now() - m_start); }
+
+private:
+    StepProfiler& m_profiler;
+    StepProfiler::Clock::time_point m_start;
+};
+
+// Time the rest of the enclosing scope.
+#ifdef PARTICLES_PROFILE
+    #define PROFILE_CONCAT_(a, b) a##b
+    #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+    #define PROFILE_STEP_PHASE(profiler, phase) ScopedPhaseTimer PROFILE_CONCAT(phaseTimer_, __LINE__)((profiler), (phase))
+    #define PROFILE_STEP(profiler) ScopedStepTimer PROFILE_CONCAT(stepTimer_, __LINE__)(profiler)
+#else
+    #define PROFILE_STEP_PHASE(profiler, phase) ((void) 0)
+    #define PROFILE_STEP(profiler) ((void) 0)
+#endif
@@ -0,0 +1,95 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(int numThreads) :
+m_generation(0), m_busyWorkers(0), m_quit(false), m_fn(nullptr), m_begin(0), m_end(0), m_chunk(1), m_nextChunk(0)
+{
+    if (numThreads <= 0)
+        numThreads = std::max(1, (int) std::thread::hardware_concurrency());
+
+    // the calling thread is the last worker
+    for (int i = 0; i < numThreads - 1; i++)
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& t : m_workers)
+        t.join();
+}
+
+int ThreadPool::getNumThreads() const
+{
+    return (int) m_workers.size() + 1;
+}
+
+void ThreadPool::runChunks()
+{
+    for (;;)
+    {
+        int c = m_nextChunk.fetch_add(1);
+        int b = m_begin + c*m_chunk;
+        if (b >= m_end) break;
+        (*m_fn)(b, std::min(b + m_chunk, m_end));
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+            if (m_quit) return;
+            seen = m_generation;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_busyWorkers == 0) m_done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& fn)
+{
+    if (end <= begin) return;
+
+    int chunk = std::max(grain, 1);
+    chunk = (chunk + kChunkAlign - 1) / kChunkAlign * kChunkAlign;
+
+    // not worth waking anybody
+    if (m_workers.empty() || end - begin <= chunk)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fn = &fn;
+        m_begin = begin;
+        m_end = end;
+        m_chunk = chunk;
+        m_nextChunk = 0;
+        m_busyWorkers = (int) m_workers.size();
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&] { return m_busyWorkers == 0; });
+    m_fn = nullptr;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads for data-parallel loops.
+// Workers are created once and sleep between jobs, so a parallelFor per
+// simulation step costs a wake-up, not a thread creation.
+class ThreadPool
+{
+public:
+    // Chunk boundaries are rounded to this many elements, so a chunk of a
+    // float or byte array spans at least a whole 64-byte cache line and two
+    // threads share at most the one line a boundary falls in (the arrays
+    // are not cache-line aligned).
+    static const int kChunkAlign = 64;
+
+    // numThreads counts the calling thread too; <= 0 means one per hardware thread
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    int getNumThreads() const;
+
+    // Runs fn(chunkBegin, chunkEnd) over [begin, end) split into chunks of
+    // ~grain elements, on the workers and the calling thread. Blocks until done.
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& fn);
+
+private:
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    unsigned m_generation;
+    int m_busyWorkers;
+    bool m_quit;
+
+    // current job
+    const std::function<void(int, int)>* m_fn;
+    int m_begin, m_end, m_chunk;
+    std::atomic<int> m_nextChunk;
+};
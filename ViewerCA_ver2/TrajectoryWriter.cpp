@@ -0,0 +1,109 @@
+#include "TrajectoryWriter.h"
+#include <algorithm>
+#include <cstring>
+
+
+TrajectoryWriter::TrajectoryWriter(Format format, int stride, size_t bufferBytes) :
+m_format(format), m_stride(std::max(stride, 1)), m_numParticles(0), m_file(nullptr), m_ok(true),
+m_buffer(std::max(bufferBytes, (size_t) 4096)), m_used(0)
+{
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    close();
+}
+
+bool TrajectoryWriter::open(const std::string& filename, int numParticles)
+{
+    close();
+
+    m_file = fopen(filename.c_str(), m_format == Format::Binary ? "wb" : "w");
+    if (m_file == nullptr) return false;
+    m_ok = true;
+
+    m_numParticles = numParticles;
+    m_positions.resize(3 * (size_t) numParticles);
+
+    if (m_format == Format::Binary)
+    {
+        std::uint32_t header[3] = { kVersion, (std::uint32_t) numParticles, (std::uint32_t) m_stride };
+        append("PTRJ", 4);
+        append(header, sizeof(header));
+    }
+    else
+    {
+        static const char kCsvHeader[] = "step,time,particle,x,y,z\n";
+        append(kCsvHeader, sizeof(kCsvHeader) - 1);
+    }
+    return true;
+}
+
+bool TrajectoryWriter::close()
+{
+    if (m_file == nullptr) return m_ok;
+    flush();
+    // fclose writes what stdio still buffers
+    m_ok = fclose(m_file) == 0 && m_ok;
+    m_file = nullptr;
+    return m_ok;
+}
+
+bool TrajectoryWriter::isOpen() const
+{
+    return m_file != nullptr;
+}
+
+bool TrajectoryWriter::writeFrame(int step, float time, const ParticleSystem& ps)
+{
+    if (m_file == nullptr) return false;
+    if (step % m_stride != 0) return m_ok;
+
+    // emitters can take the system past the size it was opened with
+    const int n = std::min(m_numParticles, ps.getNumParticles());
+    if (m_positions.size() < 3 * (size_t) ps.getNumParticles())
+        m_positions.resize(3 * (size_t) ps.getNumParticles());
+    ps.copyPositions(m_positions.data());
+
+    if (m_format == Format::Binary)
+    {
+        std::uint32_t s = (std::uint32_t) step;
+        append(&s, sizeof(s));
+        append(&time, sizeof(time));
+        // a frame always has numParticles entries, pad if the system shrank
+        std::fill(m_positions.begin() + 3*n, m_positions.begin() + 3*m_numParticles, 0.0f);
+        append(m_positions.data(), 3 * (size_t) m_numParticles * sizeof(float));
+    }
+    else
+    {
+        char line[128];
+        for (int i = 0; i < n; i++)
+        {
+            int len = snprintf(line, sizeof(line), "%d,%g,%d,%.7g,%.7g,%.7g\n", step, time, i,
+                               m_positions[3*i], m_positions[3*i + 1], m_positions[3*i + 2]);
+            append(line, (size_t) len);
+        }
+    }
+    return m_ok;
+}
+
+void TrajectoryWriter::append(const void* data, size_t bytes)
+{
+    const char* src = static_cast<const char*>(data);
+    while (bytes > 0)
+    {
+        if (m_used == m_buffer.size()) flush();
+        size_t n = std::min(bytes, m_buffer.size() - m_used);
+        memcpy(&m_buffer[m_used], src, n);
+        m_used += n;
+        src    += n;
+        bytes  -= n;
+    }
+}
+
+bool TrajectoryWriter::flush()
+{
+    if (m_used > 0) m_ok = fwrite(m_buffer.data(), 1, m_used, m_file) == m_used && m_ok;
+    m_used = 0;
+    return m_ok;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ParticleSystem.h"
+
+// Buffered sink for particle trajectories, used by the headless driver.
+//
+// Binary layout (little endian, as written by the host):
+//   header : char[4] "PTRJ", uint32 version, uint32 numParticles, uint32 stride
+//   frame  : uint32 step, float time, float xyz[3*numParticles]
+// CSV layout: one "step,time,particle,x,y,z" row per particle and frame.
+class TrajectoryWriter
+{
+public:
+    enum class Format : std::int8_t { Binary, Csv };
+
+    static const std::uint32_t kVersion = 1;
+
+    // stride: only every stride-th step passed to writeFrame is stored
+    TrajectoryWriter(Format format = Format::Binary, int stride = 1, size_t bufferBytes = 4 << 20);
+    ~TrajectoryWriter();
+
+    bool open(const std::string& filename, int numParticles);
+    // false if any write since open() failed (full disk, network error):
+    // the file is then incomplete
+    bool close();
+    bool isOpen() const;
+
+    // stores the frame if step is a multiple of the stride; false once a
+    // write has failed
+    bool writeFrame(int step, float time, const ParticleSystem& ps);
+
+private:
+    void append(const void* data, size_t bytes);
+    bool flush();
+
+    Format m_format;
+    int m_stride;
+    int m_numParticles;
+    FILE* m_file;
+    bool  m_ok; // every write since open() succeeded
+
+    std::vector<char>  m_buffer;
+    size_t             m_used;
+    std::vector<float> m_positions;
+};
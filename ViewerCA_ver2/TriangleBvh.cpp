@@ -0,0 +1,294 @@
+#include "TriangleBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+
+// whether the segment a + t*d, t in [0, tMax], touches the box
+bool segmentHitsBox(const glm::vec3& a, const glm::vec3& d, float tMax, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    float tEnter = 0.0f, tExit = tMax;
+    for (int k = 0; k < 3; k++)
+    {
+        if (d[k] == 0.0f)
+        {
+            if (a[k] < boxMin[k] || a[k] > boxMax[k]) return false;
+            continue;
+        }
+        float inv = 1.0f / d[k];
+        float t0 = (boxMin[k] - a[k]) * inv;
+        float t1 = (boxMax[k] - a[k]) * inv;
+        if (t0 > t1) std::swap(t0, t1);
+        tEnter = std::max(tEnter, t0);
+        tExit  = std::min(tExit, t1);
+        if (tEnter > tExit) return false;
+    }
+    return true;
+}
+
+float boxDistance2(const glm::vec3& p, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    glm::vec3 d = glm::max(glm::vec3(0.0f), glm::max(boxMin - p, p - boxMax));
+    return glm::dot(d, d);
+}
+
+// closest point to p on the triangle a, a + ab, a + ac (Ericson, Real-Time
+// Collision Detection, 5.1.5)
+glm::vec3 closestOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& ab, const glm::vec3& ac)
+{
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    glm::vec3 bp = ap - ab;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return a + ab;
+
+    float vc = d1*d4 - d3*d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + (d1 / (d1 - d3))*ab;
+
+    glm::vec3 cp = ap - ac;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return a + ac;
+
+    float vb = d5*d2 - d1*d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + (d2 / (d2 - d6))*ac;
+
+    float va = d3*d6 - d5*d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        return a + ab + ((d4 - d3) / ((d4 - d3) + (d5 - d6)))*(ac - ab);
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab*(vb*denom) + ac*(vc*denom);
+}
+
+}  // namespace
+
+
+TriangleBvh::TriangleBvh()
+{
+}
+
+void TriangleBvh::build(const std::vector<glm::vec3>& vertices, const std::vector<int>& indices)
+{
+    m_nodes.clear();
+    m_triangles.clear();
+
+    std::vector<Triangle> triangles;
+    std::vector<glm::vec3> centroid, boxMin, boxMax;
+    for (size_t k = 0; k + 2 < indices.size(); k += 3)
+    {
+        const glm::vec3& v0 = vertices[indices[k]];
+        const glm::vec3& v1 = vertices[indices[k + 1]];
+        const glm::vec3& v2 = vertices[indices[k + 2]];
+
+        Triangle tri;
+        tri.v0 = v0;
+        tri.e1 = v1 - v0;
+        tri.e2 = v2 - v0;
+        glm::vec3 n = glm::cross(tri.e1, tri.e2);
+        float area2 = glm::length(n);
+        if (!(area2 > 0.0f)) continue;
+        tri.normal = n / area2;
+        tri.d00 = glm::dot(tri.e1, tri.e1);
+        tri.d01 = glm::dot(tri.e1, tri.e2);
+        tri.d11 = glm::dot(tri.e2, tri.e2);
+        tri.invDenom = 1.0f / (tri.d00*tri.d11 - tri.d01*tri.d01);
+        tri.index = (int) (k / 3);
+
+        triangles.push_back(tri);
+        boxMin.push_back(glm::min(v0, glm::min(v1, v2)));
+        boxMax.push_back(glm::max(v0, glm::max(v1, v2)));
+        centroid.push_back((v0 + v1 + v2) / 3.0f);
+    }
+    if (triangles.empty()) return;
+
+    std::vector<int> order(triangles.size());
+    for (size_t k = 0; k < order.size(); k++)
+        order[k] = (int) k;
+
+    // leaves keep at least kLeafSize/2 triangles: fewer than 4T/kLeafSize + 1 nodes
+    m_nodes.reserve(4 * triangles.size() / kLeafSize + 1);
+    buildNode(order, centroid, boxMin, boxMax, 0, (int) order.size());
+
+    m_triangles.resize(triangles.size());
+    for (size_t k = 0; k < order.size(); k++)
+        m_triangles[k] = triangles[order[k]];
+}
+
+int TriangleBvh::buildNode(std::vector<int>& order, const std::vector<glm::vec3>& centroid,
+                           const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax, int begin, int end)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    Node node;
+    node.min = glm::vec3(inf);
+    node.max = glm::vec3(-inf);
+    glm::vec3 cMin(inf), cMax(-inf);
+    for (int k = begin; k < end; k++)
+    {
+        node.min = glm::min(node.min, boxMin[order[k]]);
+        node.max = glm::max(node.max, boxMax[order[k]]);
+        cMin = glm::min(cMin, centroid[order[k]]);
+        cMax = glm::max(cMax, centroid[order[k]]);
+    }
+
+    const int index = (int) m_nodes.size();
+    m_nodes.push_back(node);
+    if (end - begin <= kLeafSize)
+    {
+        m_nodes[index].first = begin;
+        m_nodes[index].count = end - begin;
+        return index;
+    }
+
+    glm::vec3 extent = cMax - cMin;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    int mid = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&](int i, int j) { return centroid[i][axis] < centroid[j][axis]; });
+
+    buildNode(order, centroid, boxMin, boxMax, begin, mid);
+    int second = buildNode(order, centroid, boxMin, boxMax, mid, end);
+    m_nodes[index].first = second;
+    m_nodes[index].count = 0;
+    return index;
+}
+
+int TriangleBvh::getNumTriangles() const
+{
+    return (int) m_triangles.size();
+}
+
+int TriangleBvh::getNumNodes() const
+{
+    return (int) m_nodes.size();
+}
+
+glm::vec3 TriangleBvh::getMin() const
+{
+    return m_nodes.empty() ? glm::vec3(std::numeric_limits<float>::infinity()) : m_nodes[0].min;
+}
+
+glm::vec3 TriangleBvh::getMax() const
+{
+    return m_nodes.empty() ? glm::vec3(-std::numeric_limits<float>::infinity()) : m_nodes[0].max;
+}
+
+bool TriangleBvh::crossTriangle(const Triangle& tri, const glm::vec3& a, const glm::vec3& b, Hit* hit) const
+{
+    float sa = glm::dot(a - tri.v0, tri.normal);
+    float sb = glm::dot(b - tri.v0, tri.normal);
+    if (!((sa > 0.0f && sb <= 0.0f) || (sa < 0.0f && sb >= 0.0f))) return false;
+
+    float t = sa / (sa - sb);
+    glm::vec3 p = a + t*(b - a);
+
+    glm::vec3 v = p - tri.v0;
+    float d20 = glm::dot(v, tri.e1);
+    float d21 = glm::dot(v, tri.e2);
+    float u = (tri.d11*d20 - tri.d01*d21) * tri.invDenom;
+    float w = (tri.d00*d21 - tri.d01*d20) * tri.invDenom;
+    if (u < 0.0f || w < 0.0f || u + w > 1.0f) return false;
+
+    hit->t = t;
+    hit->point = p;
+    hit->normal = sa > 0.0f ? tri.normal : -tri.normal;
+    hit->triangle = tri.index;
+    return true;
+}
+
+template <TriangleBvh::Query Q>
+int TriangleBvh::traverse(const glm::vec3& a, const glm::vec3& b, Hit* hit) const
+{
+    // a particle that blew up would fail no box test and visit every node
+    if (m_nodes.empty() || !std::isfinite(a.x + a.y + a.z + b.x + b.y + b.z)) return 0;
+
+    const glm::vec3 d = b - a;
+    float tMax = 1.0f;
+    int found = 0;
+
+    // a balanced tree of 2^31 triangles is less than 64 levels deep
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = m_nodes[stack[--top]];
+        if (!segmentHitsBox(a, d, tMax, node.min, node.max)) continue;
+
+        if (node.count == 0)
+        {
+            stack[top++] = node.first;
+            stack[top++] = (int) (&node - m_nodes.data()) + 1;
+            continue;
+        }
+
+        for (int k = node.first; k < node.first + node.count; k++)
+        {
+            Hit h;
+            if (!crossTriangle(m_triangles[k], a, b, &h) || h.t > tMax) continue;
+            if (Q == Query::Any) return 1;
+            if (Q == Query::Count) { found++; continue; }
+            *hit = h;
+            tMax = h.t;
+            found = 1;
+        }
+    }
+    return found;
+}
+
+bool TriangleBvh::intersect(const glm::vec3& a, const glm::vec3& b, Hit* hit) const
+{
+    return traverse<Query::Closest>(a, b, hit) > 0;
+}
+
+bool TriangleBvh::intersectsAny(const glm::vec3& a, const glm::vec3& b) const
+{
+    Hit hit;
+    return traverse<Query::Any>(a, b, &hit) > 0;
+}
+
+int TriangleBvh::countCrossings(const glm::vec3& a, const glm::vec3& b) const
+{
+    Hit hit;
+    return traverse<Query::Count>(a, b, &hit);
+}
+
+float TriangleBvh::distance(const glm::vec3& p, float maxDistance) const
+{
+    float best2 = maxDistance*maxDistance;
+    bool found = false;
+    if (m_nodes.empty() || !std::isfinite(p.x + p.y + p.z)) return std::numeric_limits<float>::infinity();
+
+    // nearer child first, so that best2 shrinks early and prunes the rest
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = m_nodes[stack[--top]];
+        if (boxDistance2(p, node.min, node.max) > best2) continue;
+
+        if (node.count == 0)
+        {
+            int first = (int) (&node - m_nodes.data()) + 1, second = node.first;
+            float d1 = boxDistance2(p, m_nodes[first].min, m_nodes[first].max);
+            float d2 = boxDistance2(p, m_nodes[second].min, m_nodes[second].max);
+            if (d1 < d2) std::swap(first, second);
+            stack[top++] = first;
+            stack[top++] = second;
+            continue;
+        }
+
+        for (int k = node.first; k < node.first + node.count; k++)
+        {
+            const Triangle& tri = m_triangles[k];
+            glm::vec3 d = p - closestOnTriangle(p, tri.v0, tri.e1, tri.e2);
+            float dist2 = glm::dot(d, d);
+            if (dist2 <= best2) { best2 = dist2; found = true; }
+        }
+    }
+    return found ? std::sqrt(best2) : std::numeric_limits<float>::infinity();
+}
@@ -0,0 +1,91 @@
+#pragma once
+#ifdef WIN32
+	#include <glm\glm.hpp>
+#else
+	#include <glm/glm.hpp>
+#endif
+#include <vector>
+
+// Bounding volume hierarchy over a triangle soup, for the continuous tests
+// of moving particles: which triangle does the segment a -> b a particle
+// swept this step go through.
+//
+// The nodes are axis-aligned boxes in one array, depth first: the first
+// child of a node follows it, the second is at its index. Each node splits
+// its triangles at the median centroid along the widest axis, down to
+// kLeafSize triangles, so the tree is balanced whatever the mesh. The
+// triangles are copied in leaf order with what the test needs precomputed.
+// A short segment only opens the few nodes whose box it crosses: O(log T)
+// per particle instead of a scan over the T triangles.
+//
+// A segment goes through a triangle when a is strictly on one side of the
+// triangle's plane, b on the other side or on it, and the crossing point is
+// inside the triangle (edges included, so a shared edge has no gap). A
+// segment that only leaves a plane it starts on does not cross it.
+class TriangleBvh
+{
+public:
+    struct Hit
+    {
+        float     t;        // crossing point = a + t*(b - a), t in (0, 1]
+        glm::vec3 point;
+        glm::vec3 normal;   // unit, on the side of a
+        int       triangle; // index in the indices given to build()
+    };
+
+    TriangleBvh();
+
+    // triangle k is vertices[indices[3k]], vertices[indices[3k+1]],
+    // vertices[indices[3k+2]]; degenerate triangles are left out
+    void build(const std::vector<glm::vec3>& vertices, const std::vector<int>& indices);
+
+    int getNumTriangles() const;
+    int getNumNodes() const;
+    // box of the whole mesh (empty: min > max)
+    glm::vec3 getMin() const;
+    glm::vec3 getMax() const;
+
+    // first triangle (smallest t) the segment a -> b crosses
+    bool intersect(const glm::vec3& a, const glm::vec3& b, Hit* hit) const;
+    // whether it crosses any; stops at the first one found
+    bool intersectsAny(const glm::vec3& a, const glm::vec3& b) const;
+    // how many it crosses (inside/outside parity of a closed mesh)
+    int countCrossings(const glm::vec3& a, const glm::vec3& b) const;
+
+    // distance from p to the nearest triangle, +infinity if there is none
+    // or it is farther than maxDistance
+    float distance(const glm::vec3& p, float maxDistance) const;
+
+    static const int kLeafSize = 4;
+
+private:
+    struct Node
+    {
+        glm::vec3 min;
+        int       first; // leaf: first triangle; inner node: second child
+        glm::vec3 max;
+        int       count; // leaf: number of triangles; inner node: 0
+    };
+
+    struct Triangle
+    {
+        glm::vec3 v0;
+        glm::vec3 e1;     // v1 - v0
+        glm::vec3 e2;     // v2 - v0
+        glm::vec3 normal; // unit, e1 x e2
+        float d00, d01, d11, invDenom; // barycentric coordinates
+        int   index;
+    };
+
+    int buildNode(std::vector<int>& order, const std::vector<glm::vec3>& centroid,
+                  const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax, int begin, int end);
+    enum class Query { Closest, Any, Count };
+
+    bool crossTriangle(const Triangle& tri, const glm::vec3& a, const glm::vec3& b, Hit* hit) const;
+    // number of crossings found: the first (Closest), any one (Any) or all (Count)
+    template <Query Q>
+    int traverse(const glm::vec3& a, const glm::vec3& b, Hit* hit) const;
+
+    std::vector<Node>     m_nodes;
+    std::vector<Triangle> m_triangles; // in leaf order
+};
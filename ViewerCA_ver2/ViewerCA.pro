@@ -20,6 +20,9 @@ CONFIG(debug, release|debug):OBJECTS_DIR = debug/
 CONFIG(debug, release|debug):MOC_DIR = debug/
 CONFIG(debug, release|debug):UI_DIR = debug/
 
+# per-phase step timers (StepProfiler.h): debug builds, or qmake CONFIG+=profile
+CONFIG(debug, release|debug)|profile:DEFINES += PARTICLES_PROFILE
+
 INCLUDEPATH += /usr/include/eigen3/
 
 LIBS += -lGLEW
@@ -29,12 +32,31 @@ SOURCES += \
     particlemanager.cpp \
     triangle_mesh.cc \
     mesh_io.cc \
+    mapped_file.cc \
+    mesh_cache.cc \
     main.cc \
     main_window.cc \
     glwidget.cc \
     camera.cc \
+    position_stream.cc \
     Plane.cpp \
     ParticleSystem.cpp \
+    ParticleStore.cpp \
+    ParticleKernels.cpp \
+    ThreadPool.cpp \
+    SpatialGrid.cpp \
+    SpringNetwork.cpp \
+    ImplicitSolver.cpp \
+    XpbdSolver.cpp \
+    AdaptiveStepper.cpp \
+    TriangleBvh.cpp \
+    Colliders.cpp \
+    SignedDistanceField.cpp \
+    ParticleEmitter.cpp \
+    ParticlePool.cpp \
+    RandomStream.cpp \
+    StepProfiler.cpp \
+    SimulationThread.cpp \
     Particle.cpp
 
 HEADERS  += \
@@ -42,11 +64,30 @@ HEADERS  += \
     particlemanager.h \
     triangle_mesh.h \
     mesh_io.h \
+    mapped_file.h \
+    mesh_cache.h \
     main_window.h \
     glwidget.h \
     camera.h \
+    position_stream.h \
     Plane.h \
     ParticleSystem.h \
+    ParticleStore.h \
+    ParticleKernels.h \
+    ThreadPool.h \
+    SpatialGrid.h \
+    SpringNetwork.h \
+    ImplicitSolver.h \
+    XpbdSolver.h \
+    AdaptiveStepper.h \
+    TriangleBvh.h \
+    Colliders.h \
+    SignedDistanceField.h \
+    ParticleEmitter.h \
+    ParticlePool.h \
+    RandomStream.h \
+    StepProfiler.h \
+    SimulationThread.h \
     Particle.h
 
 FORMS    += \
@@ -0,0 +1,124 @@
+#include "XpbdSolver.h"
+#include <algorithm>
+#include <functional>
+#include "ThreadPool.h"
+
+
+XpbdSolver::XpbdSolver() : m_iterations(10), m_sweep(Sweep::Colored), m_springScale(1.0f)
+{
+}
+
+void XpbdSolver::setIterations(int iterations)
+{
+    m_iterations = std::max(1, iterations);
+}
+
+int XpbdSolver::getIterations() const
+{
+    return m_iterations;
+}
+
+void XpbdSolver::setSweep(Sweep sweep)
+{
+    m_sweep = sweep;
+}
+
+XpbdSolver::Sweep XpbdSolver::getSweep() const
+{
+    return m_sweep;
+}
+
+void XpbdSolver::solve(const SpringNetwork& springs, float springScale, ParticleStore& particles, int numParticles,
+                       float dt, const ColliderSet& colliders, ThreadPool* pool)
+{
+    const int numSprings = springs.getNumSprings();
+    m_springScale = springScale;
+    m_lambda.assign(numSprings, 0.0f);
+    m_invMass.resize(numParticles);
+    for (int i = 0; i < numParticles; i++)
+        m_invMass[i] = particles.active[i] && !particles.fixed[i] ? 1.0f : 0.0f;
+
+    // runs fn over [begin, end) on the pool when there is one
+    auto parallel = [pool](int begin, int end, int grain, const std::function<void(int, int)>& fn) {
+        if (pool) pool->parallelFor(begin, end, grain, fn);
+        else fn(begin, end);
+    };
+
+    const std::vector<int>& colorStart = springs.getColorStart();
+    const int* colored = springs.getColoredSprings().data();
+
+    for (int it = 0; it < m_iterations; it++)
+    {
+        if (m_sweep == Sweep::Colored && springs.hasColoring())
+        {
+            for (int c = 0; c < springs.getNumColors(); c++)
+                parallel(colorStart[c], colorStart[c + 1], 2048, [&](int begin, int end) {
+                    projectSprings(springs, colored, begin, end, particles, dt);
+                });
+        }
+        else
+        {
+            projectSprings(springs, nullptr, 0, numSprings, particles, dt);
+        }
+
+        parallel(0, numParticles, 4096, [&](int begin, int end) {
+            projectColliders(begin, end, particles, colliders);
+        });
+    }
+
+    // velocities from the corrected positions
+    parallel(0, numParticles, 4096, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            if (m_invMass[i] == 0.0f) continue;
+            particles.velocity.set(i, (particles.position.get(i) - particles.previousPosition.get(i)) / dt);
+        }
+    });
+}
+
+void XpbdSolver::projectSprings(const SpringNetwork& springs, const int* order, int begin, int end,
+                                ParticleStore& particles, float dt)
+{
+    Vec3Array& position = particles.position;
+    const Vec3Array& previous = particles.previousPosition;
+
+    for (int k = begin; k < end; k++)
+    {
+        const int s = order ? order[k] : k;
+        const int a = springs.a[s], b = springs.b[s];
+        const float wa = m_invMass[a], wb = m_invMass[b];
+        const float stiffness = m_springScale * springs.stiffness[s];
+        if (wa + wb == 0.0f || !(stiffness > 0.0f)) continue;
+
+        glm::vec3 xa = position.get(a), xb = position.get(b);
+        glm::vec3 d = xa - xb;
+        float dist = glm::length(d);
+        if (!(dist > 0.0f)) continue;
+        glm::vec3 n = d / dist;
+
+        // compliance alpha/dt^2, damping gamma = alpha*beta/dt
+        float alpha = 1.0f / (stiffness * dt * dt);
+        float gamma = springs.damping[s] / (springs.stiffness[s] * dt);
+
+        float C = dist - springs.restLength[s];
+        float dC = glm::dot(n, (xa - previous.get(a)) - (xb - previous.get(b)));
+        float dLambda = (-C - alpha * m_lambda[s] - gamma * dC) / ((1.0f + gamma) * (wa + wb) + alpha);
+
+        m_lambda[s] += dLambda;
+        position.set(a, xa + (wa * dLambda) * n);
+        position.set(b, xb - (wb * dLambda) * n);
+    }
+}
+
+void XpbdSolver::projectColliders(int begin, int end, ParticleStore& particles, const ColliderSet& colliders) const
+{
+    for (int i = begin; i < end; i++)
+    {
+        if (m_invMass[i] == 0.0f) continue;
+        glm::vec3 x = particles.position.get(i);
+        glm::vec3 q = particles.previousPosition.get(i);
+        colliders.project(x, q);
+        particles.position.set(i, x);
+        particles.previousPosition.set(i, q);
+    }
+}
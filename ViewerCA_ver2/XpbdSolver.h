@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include "Colliders.h"
+#include "ParticleStore.h"
+#include "SpringNetwork.h"
+
+class ThreadPool;
+
+// Extended position-based dynamics (Macklin et al., "XPBD: Position-Based
+// Simulation of Compliant Constrained Dynamics").
+//
+// Every spring becomes a distance constraint |xa - xb| = restLength with
+// compliance 1/(springScale*stiffness) and XPBD damping from its damping
+// coefficient; the colliders are inequality constraints (ColliderSet::project:
+// the particle stays outside; a particle that starts a step inside is pushed
+// out without gaining velocity). Like the Euler methods, particles
+// are unit mass; fixed and inactive ones do not move.
+//
+// solve() runs after the prediction (EulerSemi with the external forces
+// only) has moved position and saved the start of the step in
+// previousPosition. Each iteration projects the springs, then the colliders,
+// and at the end velocity = (position - previousPosition) / dt. The cost is
+// iterations * (springs + particles) per step, for any stiffness and dt.
+//
+// GaussSeidel projects the springs one after another. Colored projects the
+// springs color by color (see SpringNetwork): springs of one color share no
+// particle, so each color is split across the thread pool. Colored needs
+// SpringNetwork::buildColoring() for the current topology, and falls back to
+// GaussSeidel without it.
+class XpbdSolver
+{
+public:
+    enum class Sweep : std::int8_t { GaussSeidel, Colored };
+
+    XpbdSolver();
+
+    void setIterations(int iterations);
+    int getIterations() const;
+    void setSweep(Sweep sweep);
+    Sweep getSweep() const;
+
+    // pool may be null (serial)
+    void solve(const SpringNetwork& springs, float springScale, ParticleStore& particles, int numParticles, float dt,
+               const ColliderSet& colliders, ThreadPool* pool);
+
+private:
+    // springs order[begin .. end), or begin .. end when order is null
+    void projectSprings(const SpringNetwork& springs, const int* order, int begin, int end, ParticleStore& particles, float dt);
+    void projectColliders(int begin, int end, ParticleStore& particles, const ColliderSet& colliders) const;
+
+    int m_iterations;
+    Sweep m_sweep;
+    float m_springScale;
+
+    std::vector<float> m_lambda;  // accumulated multiplier of each spring, reset every step
+    std::vector<float> m_invMass; // 0 for fixed/inactive particles, 1 otherwise
+};
@@ -0,0 +1,662 @@
+// Solver benchmarks, in the spirit of google-benchmark: each target runs one
+// configuration for at least -min_time seconds and reports the mean cost of
+// a step in ns/particle/step and particles/s.
+//
+// targets:
+//   BM_ParticleUpdate/<method>/<n>               Particle::updateParticle on n particles
+//   BM_IntegrationKernel/<method>/<n>            the SoA kernel ParticleSystem uses, on n particles
+//   BM_SpringForce/<n>                           ParticleSystem::getSpringForce along the chain
+//   BM_UpdateParticleSystem/<method>/<type>/<n>  ParticleSystem::updateParticleSystem
+//   BM_Collide/<colliders>/<n>                   Particle plane/sphere collision tests + response
+//   BM_MeshCollide/<triangles>/<n>               ColliderSet test + response against a triangle mesh
+//   BM_SdfCollide/<triangles>/<n>                same against the distance field of a closed mesh
+//   BM_Emit/<n>                                  updateParticleSystem with ~n fountain particles turning over each second
+//   BM_Random/<scalar|bulk>/<n>                  n uniform floats from a RandomStream, one at a time or fillUniform
+//   BM_VertexNormals/<angle|area>/<n>            ComputeVertexNormals of a mesh of ~n triangles (-threads)
+//
+// usage: ParticlesBenchmark [-filter substring] [-format console|json|csv] [-o file]
+//                           [-min_n n] [-max_n n] [-min_time seconds]
+//                           [-threads k] [-seed s]
+//
+// The json output mirrors google-benchmark's (a "context" object plus a
+// "benchmarks" array), so runs from two releases can be diffed by name.
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Colliders.h"
+#include "Particle.h"
+#include "ParticleKernels.h"
+#include "ParticleSystem.h"
+#include "Plane.h"
+#include "RandomStream.h"
+#include "SignedDistanceField.h"
+#include "Sphere.h"
+#include "ThreadPool.h"
+#include "mesh_io.h"
+#include "triangle_mesh.h"
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    std::string filter;
+    std::string format = "console";
+    std::string output;
+    long long minN = 100;
+    long long maxN = 10000000;
+    double minTime = 0.5;
+    int threads = 1;
+    unsigned seed = 1;
+};
+
+struct Result
+{
+    std::string name;
+    std::string method;
+    std::string type;
+    int colliders = 0;
+    long long numParticles = 0;
+    long long iterations = 0;
+    double seconds = 0.0;
+
+    double nsPerParticleStep() const { return seconds * 1e9 / ((double) iterations * numParticles); }
+    double particlesPerSecond() const { return (double) iterations * numParticles / seconds; }
+};
+
+const float kDt = 0.01f;
+
+// Keeps the optimizer from dropping work whose result is otherwise unused.
+volatile float g_sink;
+
+const char* MethodName(Particle::UpdateMethod method)
+{
+    switch (method)
+    {
+    case Particle::UpdateMethod::EulerOrig: return "euler";
+    case Particle::UpdateMethod::EulerSemi: return "semi";
+    case Particle::UpdateMethod::Verlet:    return "verlet";
+    case Particle::UpdateMethod::Implicit:  return "implicit";
+    case Particle::UpdateMethod::XPBD:      return "xpbd";
+    }
+    return "?";
+}
+
+const char* SystemTypeName(ParticleSystem::ParticleSystemType type)
+{
+    switch (type)
+    {
+    case ParticleSystem::ParticleSystemType::Fountain:  return "fountain";
+    case ParticleSystem::ParticleSystemType::Waterfall: return "waterfall";
+    case ParticleSystem::ParticleSystemType::Cloth:     return "cloth";
+    case ParticleSystem::ParticleSystemType::SoftBody:  return "softbody";
+    }
+    return "?";
+}
+
+const char* IsaName(KernelIsa isa)
+{
+    switch (isa)
+    {
+    case KernelIsa::Scalar: return "scalar";
+    case KernelIsa::SSE2:   return "sse2";
+    case KernelIsa::AVX2:   return "avx2";
+    }
+    return "?";
+}
+
+// Runs step() once to warm caches, then repeatedly until minTime has elapsed.
+void Measure(const Options& options, const std::function<void()>& step, Result* result)
+{
+    step();
+
+    long long iterations = 0;
+    Clock::time_point start = Clock::now();
+    double seconds = 0.0;
+    do
+    {
+        step();
+        ++iterations;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (seconds < options.minTime);
+
+    result->iterations = iterations;
+    result->seconds = seconds;
+}
+
+// Particles scattered inside the box of the default scene, falling.
+std::vector<Particle> MakeParticles(const Options& options, long long n)
+{
+    std::vector<float> xyz(3 * (size_t) n);
+    RandomStream random(options.seed, 0);
+    random.fillUniform(xyz.data(), (int) xyz.size(), -5.0f, 5.0f);
+
+    std::vector<Particle> particles((size_t) n);
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        Particle& p = particles[i];
+        glm::vec3 pos(xyz[3*i], xyz[3*i + 1], xyz[3*i + 2]);
+        p.setPosition(pos);
+        p.setPreviousPosition(pos);
+        p.setVelocity(0.0f, -1.0f, 0.0f);
+        p.setForce(0.0f, -9.81f, 0.0f);
+        p.setMass(0.1f);
+        p.setBouncing(0.8f);
+    }
+    return particles;
+}
+
+Result BenchParticleUpdate(const Options& options, Particle::UpdateMethod method, long long n)
+{
+    std::vector<Particle> particles = MakeParticles(options, n);
+
+    Result result;
+    result.method = MethodName(method);
+    result.numParticles = n;
+    Measure(options, [&]() {
+        for (Particle& p : particles)
+            p.updateParticle(kDt, method);
+    }, &result);
+    return result;
+}
+
+Result BenchIntegrationKernel(const Options& options, Particle::UpdateMethod method, long long n)
+{
+    std::vector<Particle> particles = MakeParticles(options, n);
+    ParticleStore store;
+    store.resize((int) n);
+    for (int i = 0; i < (int) n; i++)
+        store.setParticle(i, particles[i]);
+    particles.clear();
+
+    IntegrationKernel integrate = selectIntegrationKernel(method);
+    IntegrationArrays arrays(store);
+
+    Result result;
+    result.method = MethodName(method);
+    result.numParticles = n;
+    Measure(options, [&]() { integrate(arrays, 0, (int) n, kDt); }, &result);
+    return result;
+}
+
+Result BenchSpringForce(const Options& options, long long n)
+{
+    ParticleSystem ps;
+    ps.setSeed(options.seed);
+    ps.setParticleSystem((int) n);
+
+    Result result;
+    result.numParticles = n;
+    Measure(options, [&]() {
+        glm::vec3 sum(0.0f);
+        for (int i = 0; i < (int) n; i++)
+            sum += ps.getSpringForce(i);
+        g_sink = sum.x + sum.y + sum.z;
+    }, &result);
+    return result;
+}
+
+Result BenchUpdateParticleSystem(const Options& options, Particle::UpdateMethod method,
+                                 ParticleSystem::ParticleSystemType type, long long n)
+{
+    ParticleSystem ps;
+    ps.setSeed(options.seed);
+    ps.setNumThreads(options.threads);
+    ps.setParticleSystem((int) n, type);
+
+    Result result;
+    result.method = MethodName(method);
+    result.type = SystemTypeName(type);
+    result.numParticles = n;
+    Measure(options, [&]() { ps.updateParticleSystem(kDt, method); }, &result);
+    return result;
+}
+
+// A fountain that keeps about n particles alive, each living 0.5 to 1.5 s,
+// so that every step kills and spawns n*kDt of them; measured once full.
+Result BenchEmit(const Options& options, long long n)
+{
+    EmitterSettings fountain = EmitterSettings::fountain();
+    fountain.rate = (float) n;
+    fountain.lifetimeMin = 0.5f;
+    fountain.lifetimeMax = 1.5f;
+
+    ParticleSystem ps;
+    ps.setSeed(options.seed);
+    ps.setNumThreads(options.threads);
+    ps.setParticleSystem(1);
+    ps.addEmitter(fountain);
+    ps.setEmitterCapacity((int) (2 * n));
+    for (float t = 0.0f; t < 2.0f; t += kDt)
+        ps.updateParticleSystem(kDt, Particle::UpdateMethod::EulerSemi);
+
+    Result result;
+    result.method = MethodName(Particle::UpdateMethod::EulerSemi);
+    result.numParticles = n;
+    Measure(options, [&]() { ps.updateParticleSystem(kDt, Particle::UpdateMethod::EulerSemi); }, &result);
+    return result;
+}
+
+Result BenchRandom(const Options& options, bool bulk, long long n)
+{
+    std::vector<float> values((size_t) n);
+    RandomStream random(options.seed, 0);
+
+    Result result;
+    result.method = bulk ? "bulk" : "scalar";
+    result.numParticles = n;
+    Measure(options, [&]() {
+        if (bulk)
+            random.fillUniform(values.data(), (int) n, 0.0f, 1.0f);
+        else
+            for (float& v : values) v = random.uniform();
+    }, &result);
+    return result;
+}
+
+// Alternates planes and spheres; the walls of the default box first.
+void MakeColliders(const Options& options, int count, std::vector<Plane>* planes, std::vector<Sphere>* spheres)
+{
+    RandomStream random(options.seed, 1);
+    const float X = 6.0f;
+    const Plane walls[] = { Plane(0, -X, 0, 0, 1, 0), Plane(X, 0, 0, -1, 0, 0), Plane(-X, 0, 0, 1, 0, 0),
+                            Plane(0, 0, -X, 0, 0, 1), Plane(0, 0, X, 0, 0, -1) };
+    for (int k = 0; k < count; k++)
+    {
+        if (k % 2 == 0)
+            planes->push_back(walls[(k / 2) % 5]);
+        else
+        {
+            float center[3];
+            random.fillUniform(center, 3, -4.0f, 4.0f);
+            spheres->push_back(Sphere(center[0], center[1], center[2], 1.0f));
+        }
+    }
+}
+
+Result BenchCollide(const Options& options, int colliders, long long n)
+{
+    std::vector<Particle> particles = MakeParticles(options, n);
+    std::vector<Plane> planes;
+    std::vector<Sphere> spheres;
+    MakeColliders(options, colliders, &planes, &spheres);
+
+    Result result;
+    result.colliders = colliders;
+    result.numParticles = n;
+    Measure(options, [&]() {
+        for (Particle& p : particles)
+        {
+            // move a little so that some tests actually hit
+            p.updateParticle(kDt, Particle::UpdateMethod::EulerSemi);
+            for (const Plane& plane : planes)
+                if (p.collisionParticlePlane(plane)) p.correctCollisionParticlePlane(plane);
+            for (const Sphere& sphere : spheres)
+                if (p.collisionParticleSphere(sphere)) p.correctCollisionParticleSphere(sphere);
+        }
+    }, &result);
+    return result;
+}
+
+// A bumpy height field over the floor of the default box, about triangles
+// triangles, which the falling particles of MakeParticles land on.
+void MakeTerrain(int triangles, data_representation::TriangleMesh* mesh)
+{
+    int side = 1;
+    while (2 * side * side < triangles) side++;
+
+    mesh->Clear();
+    for (int z = 0; z <= side; z++)
+        for (int x = 0; x <= side; x++)
+        {
+            float u = 12.0f * x / side - 6.0f, w = 12.0f * z / side - 6.0f;
+            mesh->vertices_.push_back(u);
+            mesh->vertices_.push_back(-5.0f + 0.5f * std::sin(2.0f * u) * std::cos(3.0f * w));
+            mesh->vertices_.push_back(w);
+        }
+    for (int z = 0; z < side; z++)
+        for (int x = 0; x < side; x++)
+        {
+            int v = z * (side + 1) + x;
+            int quad[6] = { v, v + side + 1, v + 1, v + 1, v + side + 1, v + side + 2 };
+            mesh->faces_.insert(mesh->faces_.end(), quad, quad + 6);
+        }
+}
+
+// A bumpy sphere of radius about 4 in the middle of the default box, with
+// about triangles triangles.
+void MakeBlob(int triangles, data_representation::TriangleMesh* mesh)
+{
+    int rings = 2;
+    while (2 * rings * 2 * rings < triangles) rings++;
+    const int segments = 2 * rings;
+    const float pi = 3.14159265f;
+
+    mesh->Clear();
+    for (int r = 0; r <= rings; r++)
+        for (int k = 0; k < segments; k++)
+        {
+            float theta = pi * r / rings, phi = 2.0f * pi * k / segments;
+            float radius = 4.0f + 0.3f * std::sin(5.0f * theta) * std::cos(4.0f * phi);
+            mesh->vertices_.push_back(radius * std::sin(theta) * std::cos(phi));
+            mesh->vertices_.push_back(radius * std::cos(theta) - 1.0f);
+            mesh->vertices_.push_back(radius * std::sin(theta) * std::sin(phi));
+        }
+    for (int r = 0; r < rings; r++)
+        for (int k = 0; k < segments; k++)
+        {
+            int a = r * segments + k, b = r * segments + (k + 1) % segments;
+            int quad[6] = { a, b, a + segments, b, b + segments, a + segments };
+            mesh->faces_.insert(mesh->faces_.end(), quad, quad + 6);
+        }
+}
+
+// Integrates MakeParticles with EulerSemi and collides them with colliders.
+Result BenchColliderSet(const Options& options, const ColliderSet& colliders, long long n)
+{
+    ParticleStore store;
+    store.resize((int) n);
+    {
+        std::vector<Particle> particles = MakeParticles(options, n);
+        for (int i = 0; i < (int) n; i++)
+            store.setParticle(i, particles[i]);
+    }
+    IntegrationKernel integrate = selectIntegrationKernel(Particle::UpdateMethod::EulerSemi);
+    IntegrationArrays arrays(store);
+
+    Result result;
+    result.numParticles = n;
+    Measure(options, [&]() {
+        integrate(arrays, 0, (int) n, kDt);
+        for (int i = 0; i < (int) n; i++)
+        {
+            glm::vec3 prev = store.previousPosition.get(i);
+            glm::vec3 pos = store.position.get(i);
+            if (!colliders.crosses(prev, pos)) continue;
+            glm::vec3 vel = store.velocity.get(i);
+            colliders.collide(prev, pos, vel, store.bouncing[i]);
+            store.position.set(i, pos);
+            store.velocity.set(i, vel);
+        }
+    }, &result);
+    return result;
+}
+
+Result BenchMeshCollide(const Options& options, int triangles, long long n)
+{
+    data_representation::TriangleMesh mesh;
+    MakeTerrain(triangles, &mesh);
+    ColliderSet colliders;
+    colliders.addMesh(mesh, 1.0f, glm::vec3(0.0f));
+
+    Result result = BenchColliderSet(options, colliders, n);
+    result.colliders = colliders.meshes[0].getNumTriangles();
+    return result;
+}
+
+Result BenchSdfCollide(const Options& options, int triangles, long long n)
+{
+    data_representation::TriangleMesh mesh;
+    MakeBlob(triangles, &mesh);
+    auto field = std::make_shared<SignedDistanceField>();
+    ThreadPool pool(options.threads);
+    field->bake(mesh, 64, &pool);
+    ColliderSet colliders;
+    colliders.addSdf(field, 1.0f, glm::vec3(0.0f));
+
+    Result result = BenchColliderSet(options, colliders, n);
+    result.colliders = (int) mesh.faces_.size() / 3;
+    return result;
+}
+
+void PrintConsoleHeader(std::ostream& out)
+{
+    out << std::left << std::setw(56) << "Benchmark" << std::right << std::setw(12) << "Iterations"
+        << std::setw(16) << "ns/particle" << std::setw(18) << "particles/s" << "\n"
+        << std::string(102, '-') << "\n";
+}
+
+void PrintConsole(std::ostream& out, const Result& r)
+{
+    out << std::left << std::setw(56) << r.name << std::right << std::setw(12) << r.iterations
+        << std::setw(16) << std::fixed << std::setprecision(3) << r.nsPerParticleStep()
+        << std::setw(18) << std::scientific << std::setprecision(3) << r.particlesPerSecond() << "\n"
+        << std::defaultfloat;
+    out.flush();
+}
+
+void WriteCsv(std::ostream& out, const std::vector<Result>& results)
+{
+    out << "name,method,type,colliders,particles,iterations,seconds,ns_per_particle_step,particles_per_second\n";
+    out << std::setprecision(9);
+    for (const Result& r : results)
+        out << r.name << "," << r.method << "," << r.type << "," << r.colliders << "," << r.numParticles << ","
+            << r.iterations << "," << r.seconds << "," << r.nsPerParticleStep() << "," << r.particlesPerSecond() << "\n";
+}
+
+void WriteJson(std::ostream& out, const Options& options, const std::vector<Result>& results)
+{
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    out << std::setprecision(9);
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"kernel_isa\": \"" << IsaName(detectKernelIsa()) << "\",\n"
+        << "    \"solver_threads\": " << options.threads << ",\n"
+        << "    \"min_time\": " << options.minTime << ",\n"
+#ifdef NDEBUG
+        << "    \"library_build_type\": \"release\"\n"
+#else
+        << "    \"library_build_type\": \"debug\"\n"
+#endif
+        << "  },\n  \"benchmarks\": [";
+    for (size_t k = 0; k < results.size(); k++)
+    {
+        const Result& r = results[k];
+        out << (k ? "," : "") << "\n    {\n"
+            << "      \"name\": \"" << r.name << "\",\n"
+            << "      \"method\": \"" << r.method << "\",\n"
+            << "      \"type\": \"" << r.type << "\",\n"
+            << "      \"colliders\": " << r.colliders << ",\n"
+            << "      \"particles\": " << r.numParticles << ",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"real_time\": " << r.seconds << ",\n"
+            << "      \"time_unit\": \"s\",\n"
+            << "      \"ns_per_particle_step\": " << r.nsPerParticleStep() << ",\n"
+            << "      \"particles_per_second\": " << r.particlesPerSecond() << "\n"
+            << "    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// n counts triangles here
+Result BenchVertexNormals(const Options& options, data_representation::NormalWeighting weighting, long long n)
+{
+    data_representation::TriangleMesh mesh;
+    MakeBlob((int) n, &mesh);
+    ThreadPool pool(options.threads);
+
+    Result result;
+    result.numParticles = (long long) mesh.faces_.size() / 3;
+    Measure(options, [&]() {
+        data_representation::ComputeVertexNormals(mesh.vertices_, mesh.faces_, &mesh.normals_, weighting, &pool);
+        g_sink = mesh.normals_[0];
+    }, &result);
+    return result;
+}
+
+void PrintUsage(const char* program)
+{
+    std::cerr << "usage: " << program << " [-filter substring] [-format console|json|csv] [-o file]\n"
+              << "         [-min_n n] [-max_n n] [-min_time seconds] [-threads k] [-seed s]\n";
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::string value = hasValue ? argv[i + 1] : "";
+        bool ok = hasValue;
+
+        if (arg == "-filter")        options.filter = value;
+        else if (arg == "-format")
+        {
+            options.format = value;
+            ok = ok && (value == "console" || value == "json" || value == "csv");
+        }
+        else if (arg == "-o")        options.output = value;
+        else if (arg == "-min_n")    options.minN = atoll(value.c_str());
+        else if (arg == "-max_n")    options.maxN = atoll(value.c_str());
+        else if (arg == "-min_time") options.minTime = atof(value.c_str());
+        else if (arg == "-threads")  options.threads = atoi(value.c_str());
+        else if (arg == "-seed")     options.seed = (unsigned) strtoul(value.c_str(), nullptr, 10);
+        else ok = false;
+
+        if (!ok || options.minN < 2 || options.maxN < options.minN || options.minTime < 0.0)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        ++i;
+    }
+
+    // register every target; names encode the configuration
+    struct Target { std::string name; std::function<Result()> run; };
+    std::vector<Target> targets;
+
+    const Particle::UpdateMethod methods[] = { Particle::UpdateMethod::EulerOrig, Particle::UpdateMethod::EulerSemi,
+                                               Particle::UpdateMethod::Verlet };
+    const ParticleSystem::ParticleSystemType types[] = { ParticleSystem::ParticleSystemType::Fountain,
+                                                         ParticleSystem::ParticleSystemType::Waterfall,
+                                                         ParticleSystem::ParticleSystemType::Cloth,
+                                                         ParticleSystem::ParticleSystemType::SoftBody };
+    const int colliderCounts[] = { 1, 4, 16 };
+    const int triangleCounts[] = { 512, 8192, 131072 };
+
+    std::vector<long long> counts;
+    for (long long n = 100; n <= options.maxN; n *= 10)
+        if (n >= options.minN) counts.push_back(n);
+
+    for (Particle::UpdateMethod method : methods)
+        for (long long n : counts)
+            targets.push_back({ std::string("BM_ParticleUpdate/") + MethodName(method) + "/" + std::to_string(n),
+                                [&options, method, n]() { return BenchParticleUpdate(options, method, n); } });
+
+    for (Particle::UpdateMethod method : methods)
+        for (long long n : counts)
+            targets.push_back({ std::string("BM_IntegrationKernel/") + MethodName(method) + "/" + std::to_string(n),
+                                [&options, method, n]() { return BenchIntegrationKernel(options, method, n); } });
+
+    for (long long n : counts)
+        targets.push_back({ "BM_SpringForce/" + std::to_string(n),
+                            [&options, n]() { return BenchSpringForce(options, n); } });
+
+    for (Particle::UpdateMethod method : methods)
+        for (ParticleSystem::ParticleSystemType type : types)
+            for (long long n : counts)
+                targets.push_back({ std::string("BM_UpdateParticleSystem/") + MethodName(method) + "/" +
+                                    SystemTypeName(type) + "/" + std::to_string(n),
+                                    [&options, method, type, n]() { return BenchUpdateParticleSystem(options, method, type, n); } });
+
+    // the implicit solve keeps a 3n x 3n sparse matrix, so it stops at 10^6 particles
+    for (ParticleSystem::ParticleSystemType type : types)
+        for (long long n : counts)
+            if (n <= 1000000)
+                targets.push_back({ std::string("BM_UpdateParticleSystem/implicit/") + SystemTypeName(type) + "/" +
+                                    std::to_string(n),
+                                    [&options, type, n]() {
+                                        return BenchUpdateParticleSystem(options, Particle::UpdateMethod::Implicit, type, n);
+                                    } });
+
+    // XPBD only exists at the system level (the prediction is the EulerSemi kernel)
+    for (ParticleSystem::ParticleSystemType type : types)
+        for (long long n : counts)
+            targets.push_back({ std::string("BM_UpdateParticleSystem/xpbd/") + SystemTypeName(type) + "/" +
+                                std::to_string(n),
+                                [&options, type, n]() {
+                                    return BenchUpdateParticleSystem(options, Particle::UpdateMethod::XPBD, type, n);
+                                } });
+
+    for (int colliders : colliderCounts)
+        for (long long n : counts)
+            targets.push_back({ "BM_Collide/" + std::to_string(colliders) + "/" + std::to_string(n),
+                                [&options, colliders, n]() { return BenchCollide(options, colliders, n); } });
+
+    for (int triangles : triangleCounts)
+        for (long long n : counts)
+            targets.push_back({ "BM_MeshCollide/" + std::to_string(triangles) + "/" + std::to_string(n),
+                                [&options, triangles, n]() { return BenchMeshCollide(options, triangles, n); } });
+
+    for (int triangles : triangleCounts)
+        for (long long n : counts)
+            targets.push_back({ "BM_SdfCollide/" + std::to_string(triangles) + "/" + std::to_string(n),
+                                [&options, triangles, n]() { return BenchSdfCollide(options, triangles, n); } });
+
+    for (long long n : counts)
+        targets.push_back({ "BM_Emit/" + std::to_string(n), [&options, n]() { return BenchEmit(options, n); } });
+
+    for (bool bulk : { false, true })
+        for (long long n : counts)
+            targets.push_back({ std::string("BM_Random/") + (bulk ? "bulk/" : "scalar/") + std::to_string(n),
+                                [&options, bulk, n]() { return BenchRandom(options, bulk, n); } });
+
+    for (bool area : { false, true })
+        for (long long n : counts)
+            targets.push_back({ std::string("BM_VertexNormals/") + (area ? "area/" : "angle/") + std::to_string(n),
+                                [&options, area, n]() {
+                                    return BenchVertexNormals(options, area ? data_representation::NormalWeighting::kArea
+                                                                            : data_representation::NormalWeighting::kAngle, n);
+                                } });
+
+    std::ofstream file;
+    if (!options.output.empty())
+    {
+        file.open(options.output);
+        if (!file)
+        {
+            std::cerr << "Error " + options.output + " could not be opened." << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = file.is_open() ? file : std::cout;
+
+    // progress goes to the console even when the results go to a file
+    const bool console = options.format == "console";
+    std::ostream& progress = console ? out : std::cerr;
+    PrintConsoleHeader(progress);
+
+    std::vector<Result> results;
+    for (const Target& target : targets)
+    {
+        if (target.name.find(options.filter) == std::string::npos) continue;
+
+        Result r = target.run();
+        r.name = target.name;
+        PrintConsole(progress, r);
+        results.push_back(r);
+    }
+
+    if (options.format == "json") WriteJson(out, options, results);
+    else if (options.format == "csv") WriteCsv(out, results);
+    return 0;
+}
@@ -2,12 +2,14 @@
 
 #include "glwidget.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 
-#include "./mesh_io.h"
+#include "./mesh_cache.h"
 #include "./triangle_mesh.h"
 #include "./particlemanager.h"
 
@@ -26,6 +28,10 @@ const char kSkyFragmentShaderFile[] = "../shaders/sky.frag";
 
 const int kVertexAttributeIdx = 0;
 const int kNormalAttributeIdx = 1;
+const int kOffsetAttributeIdx = 2;
+
+// slots for the particles of the fountain and waterfall emitters
+const int kEmitterCapacity = 4096;
 
 /*** FRAMERATE ***/
 int FPS = 0;
@@ -73,6 +79,7 @@ bool LoadProgram(const std::string &vertex, const std::string &fragment, QOpenGL
                                      fragment_shader.c_str());
     program->bindAttributeLocation("vertex", kVertexAttributeIdx);
     program->bindAttributeLocation("normal", kNormalAttributeIdx);
+    program->bindAttributeLocation("instance_offset", kOffsetAttributeIdx);
     program->link();
   }
 
@@ -100,6 +107,16 @@ bool LoadCubeMap(const QString &dir) {
   return res;
 }
 
+// Fountain and Waterfall spray particles around the rope; the others emit none.
+void SetEmitters(ParticleSystem &ps, ParticleSystem::ParticleSystemType type) {
+  ps.clearEmitters();
+  if (type == ParticleSystem::ParticleSystemType::Fountain)
+    ps.addEmitter(EmitterSettings::fountain());
+  else if (type == ParticleSystem::ParticleSystemType::Waterfall)
+    ps.addEmitter(EmitterSettings::waterfall());
+  ps.setEmitterCapacity(ps.getNumEmitters() > 0 ? kEmitterCapacity : 0);
+}
+
 }  // namespace
 
 
@@ -111,7 +128,7 @@ ParticleSystem ps_;
 GLWidget::GLWidget(QWidget *parent)
     : QGLWidget(parent), initialized_(false), num_instances(10), width_(0.0), height_(0.0), dist_offset(1.0), myLod(0),
       my_method( "Euler (Original)" ), upd_method( Particle::UpdateMethod::EulerOrig ), psType( ParticleSystem::ParticleSystemType::Fountain ),
-      file("../models/sphere.ply")
+      adaptive_(false), file("../models/sphere.ply")
 {
   setFocusPolicy(Qt::StrongFocus);
   iniTime = time( NULL );
@@ -120,10 +137,39 @@ GLWidget::GLWidget(QWidget *parent)
   vbo_n_id = std::vector< GLuint >(10);
   faces_id = std::vector< GLuint >(10);
 
+  ps_.setNumThreads( 0 );
   ps_.setParticleSystem( num_instances );
+  SetEmitters( ps_, psType );
+
+  // 0.1 s of simulation per step, 60 steps per second: the speed the viewer
+  // used to run at when it stepped once per frame at 60 fps.
+  sim_ = std::make_unique<SimulationThread>( ps_, 0.1f, 60 );
+  sim_->setMethod( upd_method );
+  sim_->start();
+
+  connect(&repaint_timer_, SIGNAL(timeout()), this, SLOT(updateGL()));
+  repaint_timer_.start(16);
+
+#ifdef PARTICLES_PROFILE
+  timed_step_ = -1;
+  profile_overlay_ = new QLabel(this);
+  profile_overlay_->setAttribute(Qt::WA_TransparentForMouseEvents);
+  profile_overlay_->setStyleSheet("QLabel { color: white; background-color: rgba(0, 0, 0, 128); font-family: monospace; padding: 4px; }");
+  profile_overlay_->move(8, 8);
+  profile_overlay_->setText("step profile: waiting for the simulation");
+  profile_overlay_->adjustSize();
+#endif
 }
 
-GLWidget::~GLWidget() {}
+GLWidget::~GLWidget() {
+  repaint_timer_.stop();
+  sim_->stop();
+
+  if (initialized_) {
+    makeCurrent();
+    position_stream_.Release();
+  }
+}
 
 bool GLWidget::LoadModel(const QString &filename) {
   /*std::string*/ file = filename.toUtf8().constData();
@@ -135,7 +181,7 @@ bool GLWidget::LoadModel(const QString &filename) {
 
   bool res = false;
   if (type.compare("ply") == 0) {
-    res = data_representation::ReadFromPly(file, mesh.get());
+    res = data_representation::ReadFromPlyCached(file, mesh.get());
   }
 
   if (res) {
@@ -165,6 +211,11 @@ bool GLWidget::LoadModel(const QString &filename) {
     glVertexAttribPointer(kNormalAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(kNormalAttributeIdx);
 
+    // Per-instance particle positions; the buffer and offset are set every
+    // frame from position_stream_
+    glEnableVertexAttribArray(kOffsetAttributeIdx);
+    glVertexAttribDivisor(kOffsetAttributeIdx, 1);
+
     glBindVertexArray(0);
 
     // Initialize VBO for faces
@@ -190,9 +241,13 @@ bool GLWidget::LoadSphere( ) {
   std::unique_ptr<data_representation::TriangleMesh> mesh2 =
       std::make_unique<data_representation::TriangleMesh>();
 
+  // Positions and normals interleaved, uploaded as they are.
+  std::vector<float> interleaved;
+
   bool res = false;
   if (type.compare("ply") == 0) {
-    res = data_representation::ReadFromPly(sphFile, mesh2.get());
+    res = data_representation::ReadFromPlyCached(sphFile, mesh2.get(),
+                                                 &interleaved);
   }
 
   if (res) {
@@ -202,19 +257,13 @@ bool GLWidget::LoadSphere( ) {
     glGenVertexArrays(1, &VAO_sph);
     glBindVertexArray(VAO_sph);
 
-    // Initialize VBO for vertices
+    // Initialize VBO for vertices and normals
     glGenBuffers(1, &vbo_v_id_sph);
     glBindBuffer(GL_ARRAY_BUFFER, vbo_v_id_sph);
-    glBufferData(GL_ARRAY_BUFFER, mesh2_->vertices_.size() * sizeof(float), &mesh2_->vertices_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(kVertexAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBufferData(GL_ARRAY_BUFFER, interleaved.size() * sizeof(float), &interleaved[0], GL_STATIC_DRAW);
+    glVertexAttribPointer(kVertexAttributeIdx, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 0);
     glEnableVertexAttribArray(kVertexAttributeIdx);
-
-
-    // Initialize VBO for normals
-    glGenBuffers(1, &vbo_n_id_sph);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_n_id_sph);
-    glBufferData(GL_ARRAY_BUFFER, mesh2_->normals_.size() * sizeof(float), &mesh2_->normals_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(kNormalAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(kNormalAttributeIdx, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), reinterpret_cast<void *>(3 * sizeof(float)));
     glEnableVertexAttribArray(kNormalAttributeIdx);
 
     glBindVertexArray(0);
@@ -303,14 +352,28 @@ void GLWidget::keyPressEvent(QKeyEvent *event) {
   if (event->key() == Qt::Key_D) camera_.Move( 0, 1);
 
   if (event->key() == Qt::Key_Z) camera_.Zoom(-10);
+#ifdef PARTICLES_PROFILE
+  if (event->key() == Qt::Key_P) profile_overlay_->setVisible(!profile_overlay_->isVisible());
+#endif
   if (event->key() == Qt::Key_X) camera_.Zoom(10);
 
   if (event->key() == Qt::Key_Q) camera_.Rotate(-1);
   if (event->key() == Qt::Key_E) camera_.Rotate(1);
 
+  if (event->key() == Qt::Key_T) {
+    adaptive_ = !adaptive_;
+    sim_->setAdaptive(adaptive_);
+    std::cout << "Adaptive substeps " << (adaptive_ ? "on" : "off") << "\n";
+  }
+
   if (event->key() == Qt::Key_R)
   {
-    ps_.setParticleSystem( num_instances );
+    GLuint n = num_instances;
+    ParticleSystem::ParticleSystemType type = psType;
+    sim_->post([n, type](ParticleSystem &ps) {
+        SetEmitters( ps, type );
+        ps.setParticleSystem( n, type );
+    });
 
     phong_program_.reset();
     phong_program_ = std::make_unique<QOpenGLShaderProgram>();
@@ -367,25 +430,45 @@ void GLWidget::paintGL() {
       if ( endTime > iniTime ) {
           myFPS = FPS / (endTime - iniTime);
           emit SetFramerate(QString( std::to_string( myFPS ).c_str() ));
+#ifdef PARTICLES_PROFILE
+          UpdateProfileOverlay();
+#endif
           iniTime = endTime;
           FPS = 0;
       }
 
-      for( int i = 0; i < (int) num_instances ; ++i)
-      {
-          glm::vec3 myPart = ps_.getParticle( i ).getCurrentPosition();
-          glUniform3f(offset_location, myPart.x, myPart.y, myPart.z );
+      // All particles in one draw call: positions go to the per-instance
+      // attribute buffer, the offset uniform stays at the origin. The latest
+      // simulation snapshot is copied into the mapped ring segment: one copy
+      // more than writing there from the simulation, which would have to
+      // wait on this thread's GL fences instead of never blocking.
+      const SimulationSnapshot &snapshot = sim_->acquireSnapshot();
+#ifdef PARTICLES_PROFILE
+      if ( snapshot.step != timed_step_ ) {
+          step_timings_ += snapshot.timings;
+          timed_step_ = snapshot.step;
+      }
+#endif
+      // the scene and the emitted particles; the snapshot may still be of
+      // the system before the last change
+      int num_particles = snapshot.numParticles;
+      float *positions = position_stream_.BeginWrite( snapshot.positions.size() );
+      std::copy( snapshot.positions.begin(), snapshot.positions.end(), positions );
+      GLintptr positions_offset = position_stream_.EndWrite();
 
-          // TODO(students): Implement model rendering.
-          glBindVertexArray(VAO[ myLod ]);
-          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faces_id[ myLod ]);
+      glUniform3f(offset_location, 0, 0, 0 );
 
-          glDrawElements(GL_TRIANGLES, mesh_->faces_.size(), GL_UNSIGNED_INT, 0);
-          //glDrawElementsInstanced(GL_TRIANGLES, PartMan.facesPerLOD[ myLod ].size(), GL_UNSIGNED_INT, 0, num_instances * num_instances);
+      glBindVertexArray(VAO[ myLod ]);
+      glBindBuffer(GL_ARRAY_BUFFER, position_stream_.buffer());
+      glVertexAttribPointer(kOffsetAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void *>(positions_offset));
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faces_id[ myLod ]);
 
-          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-          glBindVertexArray(0);
-      }
+      glDrawElementsInstanced(GL_TRIANGLES, mesh_->faces_.size(), GL_UNSIGNED_INT, 0, num_particles);
+      position_stream_.Fence();
+
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+      glBindVertexArray(0);
 
 // /////////////// Box BEGIN
 
@@ -495,18 +578,18 @@ void GLWidget::paintGL() {
           glBindVertexArray(VAO[ myLod ]);
           glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faces_id[ myLod ]);
 
+          // single copy: no per-instance particle offset
+          glDisableVertexAttribArray(kOffsetAttributeIdx);
+          glVertexAttrib3f(kOffsetAttributeIdx, 0, 0, 0);
           glDrawElements(GL_TRIANGLES, mesh_->faces_.size(), GL_UNSIGNED_INT, 0);
-          //glDrawElementsInstanced(GL_TRIANGLES, PartMan.facesPerLOD[ myLod ].size(), GL_UNSIGNED_INT, 0, num_instances * num_instances);
+          glEnableVertexAttribArray(kOffsetAttributeIdx);
 
           glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
           glBindVertexArray(0);
     }
 
 // ////////////////////// MODEL PAINTING END
-      if (myFPS == 0.0f)
-          myFPS = 1.0f;
-      float RATE = 1.0f;
-      ps_.updateParticleSystem( RATE*0.1f, upd_method ); // ::EulerOrig | ::EulerSemi | ::Verlet
+      // the simulation advances on sim_, not here
 
       emit SetFaces(    QString(std::to_string(PartMan.facesPerLOD[ myLod ].size() / 3).c_str()) );
       emit SetVertices( QString(std::to_string(PartMan.vtxPerLOD[ myLod ].size()   / 3).c_str()) );
@@ -517,10 +600,34 @@ void GLWidget::paintGL() {
   }
 }
 
+#ifdef PARTICLES_PROFILE
+void GLWidget::UpdateProfileOverlay() {
+  if (step_timings_.steps == 0) return;
+
+  // phases that run on the pool are summed over the workers
+  const double scale = 1e3 / step_timings_.steps;
+  std::string text;
+  char line[96];
+  std::snprintf(line, sizeof(line), "%-21s %8.3f ms", "step (wall)", step_timings_.stepSeconds * scale);
+  text += line;
+  for (int p = 0; p < kNumStepPhases; ++p) {
+    std::snprintf(line, sizeof(line), "\n%-21s %8.3f ms", stepPhaseName((StepPhase) p), step_timings_.phaseSeconds[p] * scale);
+    text += line;
+  }
+  std::snprintf(line, sizeof(line), "\nmean of %d steps", step_timings_.steps);
+  text += line;
+
+  profile_overlay_->setText(QString::fromStdString(text));
+  profile_overlay_->adjustSize();
+  step_timings_ = StepTimings();
+}
+#endif
+
 void GLWidget::SetNumInstances(int numInst) {
     num_instances = numInst;
     std::cout << "There are " << numInst << " particles\n";
-    ps_.setParticleSystem( num_instances, psType );
+    ParticleSystem::ParticleSystemType type = psType;
+    sim_->post([numInst, type](ParticleSystem &ps) { ps.setParticleSystem( numInst, type ); });
     updateGL();
 }
 
@@ -541,7 +648,22 @@ void GLWidget::SetLevelOfDetail(int myLod) {
         std::cout << "Particle System set to: WATERFALL\n";
         psType = ParticleSystem::ParticleSystemType::Waterfall;
     }
-    ps_.setParticleSystem( num_instances, psType );
+    else if (myLod == 3)
+    {
+        std::cout << "Particle System set to: CLOTH\n";
+        psType = ParticleSystem::ParticleSystemType::Cloth;
+    }
+    else if (myLod == 4)
+    {
+        std::cout << "Particle System set to: SOFT BODY\n";
+        psType = ParticleSystem::ParticleSystemType::SoftBody;
+    }
+    GLuint n = num_instances;
+    ParticleSystem::ParticleSystemType type = psType;
+    sim_->post([n, type](ParticleSystem &ps) {
+        SetEmitters( ps, type );
+        ps.setParticleSystem( n, type );
+    });
     updateGL();
 }
 
@@ -563,33 +685,47 @@ void GLWidget::SetMethod(QString method) {
         std::cout << "Method = [" << my_method << "]\n";
         upd_method = Particle::UpdateMethod::Verlet;
     }
+    else if (my_method == "Implicit Euler")
+    {
+        std::cout << "Method = [" << my_method << "]\n";
+        upd_method = Particle::UpdateMethod::Implicit;
+    }
+    else if (my_method == "XPBD")
+    {
+        std::cout << "Method = [" << my_method << "]\n";
+        upd_method = Particle::UpdateMethod::XPBD;
+    }
+    sim_->setMethod( upd_method );
     updateGL();
 }
 
 
 
 
-// they all reset the particle system!!!
+// damping and elasticity change the springs in place; a new length needs
+// a new layout, so it resets the particle system (on the simulation thread)
 
 void GLWidget::SetDamping(double val)
 {
-    ps_.setSpringDamping( (float) val );
-    ps_.setParticleSystem( num_instances, psType );
+    sim_->post([val](ParticleSystem &ps) { ps.setSpringDamping( (float) val ); });
     updateGL();
 }
 
 
 void GLWidget::SetElasticity(double val)
 {
-    ps_.setSpringElasticity( (float) val );
-    ps_.setParticleSystem( num_instances, psType );
+    sim_->post([val](ParticleSystem &ps) { ps.setSpringElasticity( (float) val ); });
     updateGL();
 }
 
 
 void GLWidget::SetLength(double val)
 {
-    ps_.setSpringLength( (float) val );
-    ps_.setParticleSystem( num_instances, psType );
+    GLuint n = num_instances;
+    ParticleSystem::ParticleSystemType type = psType;
+    sim_->post([val, n, type](ParticleSystem &ps) {
+        ps.setSpringLength( (float) val );
+        ps.setParticleSystem( n, type );
+    });
     updateGL();
 }
@@ -6,15 +6,19 @@
 #include <GL/glew.h>
 #include <QGLWidget>
 #include <QImage>
+#include <QLabel>
 #include <QMouseEvent>
 #include <QOpenGLShaderProgram>
 #include <QString>
+#include <QTimer>
 
 #include <memory>
 
 #include "./camera.h"
+#include "./position_stream.h"
 #include "./triangle_mesh.h"
 #include "./ParticleSystem.h"
+#include "./SimulationThread.h"
 
 class GLWidget : public QGLWidget {
   Q_OBJECT
@@ -96,6 +100,12 @@ class GLWidget : public QGLWidget {
   */
   std::vector< GLuint > faces_id;
 
+  /**
+  * @brief position_stream_ Triple-buffered, persistently mapped vertex buffer
+  * with the per-instance particle positions (attribute divisor 1).
+  */
+  data_visualization::PositionStream position_stream_;
+
 
   /**
    * @brief VAO Vertex Array Object id for sphere.
@@ -103,13 +113,10 @@ class GLWidget : public QGLWidget {
   GLuint VAO_sph;
 
   /**
-   * @brief vbo_v_id Vertex Buffer id for sphere's vertices.
+   * @brief vbo_v_id Vertex Buffer id for sphere's vertices and normals,
+   * interleaved.
    */
   GLuint vbo_v_id_sph;
-  /**
-  * @brief vbo_n_id Vertex Buffer id for sphere's normals.
-  */
-  GLuint vbo_n_id_sph;
 
   /**
   * @brief faces_id Vertex Buffer id for sphere's faces.
@@ -174,6 +181,41 @@ class GLWidget : public QGLWidget {
   Particle::UpdateMethod upd_method;
   ParticleSystem::ParticleSystemType psType;
 
+  /**
+  * @brief adaptive_ Whether each simulation step is split into adaptive
+  * substeps (toggled with T).
+  */
+  bool adaptive_;
+
+  /**
+  * @brief sim_ Steps ps_ on its own thread at a fixed timestep. The widget
+  * only reads its snapshots and posts parameter changes to it.
+  */
+  std::unique_ptr<SimulationThread> sim_;
+
+  /**
+  * @brief repaint_timer_ Triggers a repaint per display frame, independent of
+  * the simulation rate.
+  */
+  QTimer repaint_timer_;
+
+#ifdef PARTICLES_PROFILE
+  /**
+  * @brief step_timings_ Per-phase step times of the snapshots shown since the
+  * overlay was last refreshed.
+  */
+  StepTimings step_timings_;
+  long timed_step_;
+
+  /**
+  * @brief profile_overlay_ Label drawn over the viewport with the mean time
+  * per step of each phase. Toggled with P.
+  */
+  QLabel *profile_overlay_;
+
+  void UpdateProfileOverlay();
+#endif
+
 
   /**
   * @brief file Model filename.
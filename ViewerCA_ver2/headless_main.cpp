@@ -0,0 +1,315 @@
+// Headless batch driver: runs a ParticleSystem without Qt/OpenGL and dumps
+// the trajectories to a CSV or binary file, and optionally every frame to a
+// PLY point cloud.
+//
+// usage: ParticlesHeadless [-n particles] [-t steps] [-dt seconds]
+//                          [-m euler|semi|verlet|implicit|xpbd] [-s fountain|waterfall|cloth|softbody]
+//                          [-o file] [-f bin|csv] [-stride k] [-threads k]
+//                          [-seed s] [-radius r] [-iters k] [-sweep serial|colored]
+//                          [-damping d] [-adaptive tolerance] [-courant c]
+//                          [-mesh file.ply] [-sdf file.ply] [-sdf-res cells]
+//                          [-emit fountain|waterfall] [-rate r] [-capacity k]
+//                          [-ply pattern]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "ParticleSystem.h"
+#include "PlyFrameWriter.h"
+#include "SignedDistanceField.h"
+#include "ThreadPool.h"
+#include "TrajectoryWriter.h"
+#include "mesh_cache.h"
+#include "triangle_mesh.h"
+
+
+namespace {
+
+void PrintUsage(const char* program)
+{
+    std::cerr << "usage: " << program << " [-n particles] [-t steps] [-dt seconds]\n"
+              << "         [-m euler|semi|verlet|implicit|xpbd] [-s fountain|waterfall|cloth|softbody]\n"
+              << "         [-o file] [-f bin|csv] [-stride k] [-threads k] [-seed s]\n"
+              << "         [-radius r]  (enables particle-particle collisions)\n"
+              << "         [-iters k] [-sweep serial|colored]  (xpbd solver)\n"
+              << "         [-damping d]  (verlet, fraction of the displacement lost per step)\n"
+              << "         [-adaptive tolerance] [-courant c]  (-dt is a frame, split into substeps)\n"
+              << "         [-mesh file.ply]  (collider in place of the sphere, scaled to its size; cached in file.mesh)\n"
+              << "         [-sdf file.ply] [-sdf-res cells]  (same, as a distance field cached in file.sdf)\n"
+              << "         [-emit fountain|waterfall] [-rate r] [-capacity k]  (emitter of r particles/s into k slots)\n"
+              << "         [-ply pattern]  (frames as PLY point clouds, e.g. frames/p_%05d.ply; same stride)\n";
+}
+
+bool ParseMethod(const std::string& name, Particle::UpdateMethod* method)
+{
+    if (name == "euler")         *method = Particle::UpdateMethod::EulerOrig;
+    else if (name == "semi")     *method = Particle::UpdateMethod::EulerSemi;
+    else if (name == "verlet")   *method = Particle::UpdateMethod::Verlet;
+    else if (name == "implicit") *method = Particle::UpdateMethod::Implicit;
+    else if (name == "xpbd")     *method = Particle::UpdateMethod::XPBD;
+    else return false;
+    return true;
+}
+
+bool ParseSystemType(const std::string& name, ParticleSystem::ParticleSystemType* type)
+{
+    if (name == "fountain")       *type = ParticleSystem::ParticleSystemType::Fountain;
+    else if (name == "waterfall") *type = ParticleSystem::ParticleSystemType::Waterfall;
+    else if (name == "cloth")     *type = ParticleSystem::ParticleSystemType::Cloth;
+    else if (name == "softbody")  *type = ParticleSystem::ParticleSystemType::SoftBody;
+    else return false;
+    return true;
+}
+
+bool ParseEmitter(const std::string& name, EmitterSettings* settings)
+{
+    if (name == "fountain")       *settings = EmitterSettings::fountain();
+    else if (name == "waterfall") *settings = EmitterSettings::waterfall();
+    else return false;
+    return true;
+}
+
+// Scale and translation that fit the box [lo, hi] to the first sphere of
+// the scene: largest side its diameter, resting on the floor below it. The
+// spheres are removed; false if there is none.
+bool TakeSpherePlace(ColliderSet* colliders, const glm::vec3& lo, const glm::vec3& hi, float* scale,
+                     glm::vec3* translation)
+{
+    if (colliders->spheres.empty()) return false;
+    const Sphere sph = colliders->spheres[0];
+    glm::vec3 size = hi - lo;
+    *scale = 2.0f * sph.radius / std::max(size.x, std::max(size.y, size.z));
+    glm::vec3 center = 0.5f * (lo + hi);
+    *translation = glm::vec3(sph.center.x - *scale * center.x, sph.center.y - sph.radius - *scale * lo.y,
+                             sph.center.z - *scale * center.z);
+    colliders->spheres.clear();
+    return true;
+}
+
+bool ReplaceSphereByMesh(const std::string& filename, ColliderSet* colliders)
+{
+    data_representation::TriangleMesh mesh;
+    if (!data_representation::ReadFromPlyCached(filename, &mesh) || mesh.faces_.empty())
+        return false;
+
+    float scale;
+    glm::vec3 translation;
+    if (!TakeSpherePlace(colliders, glm::vec3(mesh.min_.x(), mesh.min_.y(), mesh.min_.z()),
+                         glm::vec3(mesh.max_.x(), mesh.max_.y(), mesh.max_.z()), &scale, &translation))
+        return false;
+    colliders->addMesh(mesh, scale, translation);
+    return true;
+}
+
+bool ReplaceSphereBySdf(const std::string& filename, int resolution, int threads, ColliderSet* colliders)
+{
+    auto field = std::make_shared<SignedDistanceField>();
+    ThreadPool pool(threads);
+    bool fromCache;
+    auto start = std::chrono::steady_clock::now();
+    if (!field->loadOrBake(filename, resolution, &pool, &fromCache) || field->isEmpty())
+        return false;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    float scale;
+    glm::vec3 translation;
+    if (!TakeSpherePlace(colliders, field->getMeshMin(), field->getMeshMax(), &scale, &translation))
+        return false;
+    colliders->addSdf(field, scale, translation);
+
+    glm::vec3 cells = (field->getMax() - field->getMin()) / field->getCellSize();
+    std::cout << "SDF collider: " << (int) cells.x << " x " << (int) cells.y << " x " << (int) cells.z << " cells, "
+              << (fromCache ? "read from " : "baked in ") << (fromCache ? SignedDistanceField::getCacheFileName(filename)
+              : std::to_string(seconds) + " s") << std::endl;
+    return true;
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[])
+{
+    int numParticles = 1000;
+    int steps = 1000;
+    float dt = 0.01f;
+    int stride = 1;
+    int threads = 0;
+    std::uint64_t seed = 1;
+    float radius = 0.0f;
+    int iterations = 10;
+    float damping = kDefaultDamping;
+    float tolerance = 0.0f; // > 0: adaptive substeps
+    float courant = 0.5f;
+    XpbdSolver::Sweep sweep = XpbdSolver::Sweep::Colored;
+    std::string output = "trajectory.bin";
+    std::string plyPattern;
+    std::string meshFile;
+    std::string sdfFile;
+    int sdfResolution = 64;
+    bool emit = false;
+    EmitterSettings emitter;
+    float rate = -1.0f; // < 0: the rate of the emitter
+    int capacity = 4096;
+    TrajectoryWriter::Format format = TrajectoryWriter::Format::Binary;
+    Particle::UpdateMethod method = Particle::UpdateMethod::EulerSemi;
+    ParticleSystem::ParticleSystemType type = ParticleSystem::ParticleSystemType::Fountain;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::string value = hasValue ? argv[i + 1] : "";
+        bool ok = hasValue;
+
+        if (arg == "-n")           numParticles = atoi(value.c_str());
+        else if (arg == "-t")      steps = atoi(value.c_str());
+        else if (arg == "-dt")     dt = (float) atof(value.c_str());
+        else if (arg == "-stride") stride = atoi(value.c_str());
+        else if (arg == "-threads") threads = atoi(value.c_str());
+        else if (arg == "-seed")   seed = strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "-radius") radius = (float) atof(value.c_str());
+        else if (arg == "-iters")  iterations = atoi(value.c_str());
+        else if (arg == "-damping") damping = (float) atof(value.c_str());
+        else if (arg == "-adaptive") tolerance = (float) atof(value.c_str());
+        else if (arg == "-courant") courant = (float) atof(value.c_str());
+        else if (arg == "-sweep")
+        {
+            if (value == "serial")       sweep = XpbdSolver::Sweep::GaussSeidel;
+            else if (value == "colored") sweep = XpbdSolver::Sweep::Colored;
+            else ok = false;
+        }
+        else if (arg == "-o")      output = value;
+        else if (arg == "-ply")    plyPattern = value;
+        else if (arg == "-mesh")   meshFile = value;
+        else if (arg == "-sdf")    sdfFile = value;
+        else if (arg == "-sdf-res") sdfResolution = atoi(value.c_str());
+        else if (arg == "-emit")
+        {
+            emit = true;
+            ok = ok && ParseEmitter(value, &emitter);
+        }
+        else if (arg == "-rate")   rate = (float) atof(value.c_str());
+        else if (arg == "-capacity") capacity = atoi(value.c_str());
+        else if (arg == "-m")      ok = ok && ParseMethod(value, &method);
+        else if (arg == "-s")      ok = ok && ParseSystemType(value, &type);
+        else if (arg == "-f")
+        {
+            if (value == "bin")      format = TrajectoryWriter::Format::Binary;
+            else if (value == "csv") format = TrajectoryWriter::Format::Csv;
+            else ok = false;
+        }
+        else ok = false;
+
+        if (!ok || numParticles < 1 || steps < 0 || dt <= 0.0f || iterations < 1 ||
+            tolerance < 0.0f || courant <= 0.0f || sdfResolution < 1 || capacity < 0)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        ++i;
+    }
+
+    ParticleSystem ps;
+    ps.setSeed(seed);
+    ps.setNumThreads(threads);
+    if (radius > 0.0f)
+    {
+        ps.setParticleRadius(radius);
+        ps.setParticleCollisions(true);
+    }
+    ps.getXpbdSolver().setIterations(iterations);
+    ps.getXpbdSolver().setSweep(sweep);
+    ps.setDamping(damping);
+    ps.getStepper().setTolerance(tolerance);
+    ps.getStepper().setCourantNumber(courant);
+    ps.setParticleSystem(numParticles, type);
+    if (emit)
+    {
+        if (rate >= 0.0f) emitter.rate = rate;
+        ps.addEmitter(emitter);
+        ps.setEmitterCapacity(capacity);
+    }
+    if (!meshFile.empty())
+    {
+        if (!ReplaceSphereByMesh(meshFile, &ps.getColliders()))
+        {
+            std::cerr << "Error " + meshFile + " could not be read." << std::endl;
+            return 1;
+        }
+        const TriangleBvh& bvh = ps.getColliders().meshes.back();
+        std::cout << "Mesh collider: " << bvh.getNumTriangles() << " triangles, " << bvh.getNumNodes()
+                  << " BVH nodes" << std::endl;
+    }
+    if (!sdfFile.empty() && !ReplaceSphereBySdf(sdfFile, sdfResolution, threads, &ps.getColliders()))
+    {
+        std::cerr << "Error " + sdfFile + " could not be read." << std::endl;
+        return 1;
+    }
+
+    PlyFrameWriter plyWriter(plyPattern, stride);
+    if (!plyPattern.empty() && !plyWriter.isValid())
+    {
+        std::cerr << "Error " + plyPattern + " needs exactly one %d conversion for the step, e.g. frames/p_%05d.ply."
+                  << std::endl;
+        return 1;
+    }
+
+    TrajectoryWriter writer(format, stride);
+    // dead emitter slots are written as zeros
+    if (!writer.open(output, numParticles + ps.getEmitterCapacity()))
+    {
+        std::cerr << "Error " + output + " could not be opened." << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    long long substeps = 0;
+    for (int step = 0; step <= steps; step++)
+    {
+        if (step > 0 && tolerance > 0.0f)
+            substeps += ps.advance(dt, method);
+        else if (step > 0)
+            ps.updateParticleSystem(dt, method);
+        if (!writer.writeFrame(step, step * dt, ps))
+        {
+            std::cerr << "Error " + output + " could not be written." << std::endl;
+            return 1;
+        }
+        if (!plyPattern.empty() && !plyWriter.writeFrame(step, step * dt, ps))
+        {
+            std::cerr << "Error " + plyWriter.filename(step) + " could not be written." << std::endl;
+            return 1;
+        }
+    }
+    if (!writer.close())
+    {
+        std::cerr << "Error " + output + " could not be written." << std::endl;
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Simulated " << numParticles << " particles x " << steps << " steps on "
+              << ps.getNumThreads() << " thread(s) in " << seconds << " s ("
+              << (seconds > 0.0 ? numParticles * (double) steps / seconds : 0.0) << " particle-steps/s)" << std::endl;
+    if (emit)
+        std::cout << "Emitter: " << ps.getNumEmitted() << " of " << capacity << " slots alive at the end" << std::endl;
+    if (tolerance > 0.0f && steps > 0)
+        std::cout << "Adaptive: " << substeps << " substeps, " << (double) substeps / steps << " per step" << std::endl;
+
+#ifdef PARTICLES_PROFILE
+    StepTimings timings = ps.takeStepTimings();
+    if (timings.steps > 0)
+    {
+        std::cout << "Mean per step: " << 1e3 * timings.stepSeconds / timings.steps << " ms" << std::endl;
+        for (int p = 0; p < kNumStepPhases; p++)
+            std::cout << "  " << stepPhaseName((StepPhase) p) << ": "
+                      << 1e3 * timings.phaseSeconds[p] / timings.steps << " ms" << std::endl;
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Author: Marc Comino 2020
+
+#include <mapped_file.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace data_representation {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : data_(nullptr), size_(0), file_(nullptr), mapping_(nullptr) {}
+
+bool MappedFile::Open(const std::string &filename) {
+  Close();
+
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  file_ = file;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+    Close();
+    return false;
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    Close();
+    return false;
+  }
+  mapping_ = mapping;
+
+  data_ = static_cast<const char *>(
+      MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (data_ == nullptr) {
+    Close();
+    return false;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) UnmapViewOfFile(data_);
+  if (mapping_ != nullptr) CloseHandle(static_cast<HANDLE>(mapping_));
+  if (file_ != nullptr) CloseHandle(static_cast<HANDLE>(file_));
+  data_ = nullptr;
+  size_ = 0;
+  mapping_ = nullptr;
+  file_ = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+bool MappedFile::Open(const std::string &filename) {
+  Close();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+
+  // The mapping keeps its own reference to the file.
+  void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+
+  // Loaders read front to back: let the kernel read ahead aggressively.
+  madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+  data_ = static_cast<const char *>(data);
+  size_ = static_cast<size_t>(info.st_size);
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) munmap(const_cast<char *>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() { Close(); }
+
+bool HashFile(const std::string &filename, uint64_t *hash) {
+  MappedFile file;
+  if (!file.Open(filename)) return false;
+
+  uint64_t h = 14695981039346656037ull;
+  const unsigned char *data =
+      reinterpret_cast<const unsigned char *>(file.data());
+  for (size_t i = 0; i < file.size(); ++i) h = (h ^ data[i]) * 1099511628211ull;
+
+  *hash = h;
+  return true;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,59 @@
+// Author: Marc Comino 2020
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace data_representation {
+
+/**
+ * @brief The MappedFile class Read-only memory mapping of a whole file. The
+ * pages are loaded on demand straight from the page cache, so reading the
+ * file costs no read() calls and no intermediate buffers.
+ */
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  /**
+   * @brief Open Maps the file at the path filename, unmapping the previous
+   * one if any.
+   * @return Whether the file could be opened and mapped. Empty files cannot.
+   */
+  bool Open(const std::string &filename);
+
+  /**
+   * @brief Close Unmaps the file. Pointers into data() become invalid.
+   */
+  void Close();
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data_;
+  size_t size_;
+#ifdef _WIN32
+  void *file_;
+  void *mapping_;
+#endif
+};
+
+/**
+ * @brief HashFile FNV-1a of the contents of the file at the path filename,
+ * read through a mapping. The mesh and distance field caches use it to tell
+ * whether their source changed.
+ * @return Whether the file could be mapped. Empty files cannot.
+ */
+bool HashFile(const std::string &filename, uint64_t *hash);
+
+}  // namespace data_representation
+
+#endif  // MAPPED_FILE_H_
@@ -0,0 +1,337 @@
+// Author: Marc Comino 2020
+
+#include <mesh_cache.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "./mapped_file.h"
+#include "./mesh_io.h"
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+namespace {
+
+const char kMagic[4] = {'M', 'S', 'H', 'C'};
+const uint32_t kByteOrderMark = 0x01020304u;
+const uint64_t kSectionAlignment = 64;
+
+enum Section {
+  kVertices,
+  kFaces,
+  kNormals,
+  kColors,
+  kTexcoords,
+  kInterleaved,
+  kNumSections
+};
+
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t reserved;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint64_t source_hash;
+  uint64_t num_vertices;
+  uint64_t num_triangles;
+  float min[3];
+  float max[3];
+  uint64_t offsets[kNumSections];
+};
+
+static_assert(sizeof(CacheHeader) == 128, "the cache header is 128 bytes");
+
+/**
+ * @brief SectionBytes Size of each section of a mesh with the given counts.
+ */
+uint64_t SectionBytes(Section section, uint64_t num_vertices,
+                      uint64_t num_triangles) {
+  switch (section) {
+    case kVertices:
+    case kNormals:
+    case kColors:
+      return num_vertices * 3 * sizeof(float);
+    case kFaces:
+      return num_triangles * 3 * sizeof(int);
+    case kTexcoords:
+      return num_vertices * 2 * sizeof(float);
+    case kInterleaved:
+      return num_vertices * 6 * sizeof(float);
+    default:
+      return 0;
+  }
+}
+
+uint64_t Align(uint64_t offset) {
+  return (offset + kSectionAlignment - 1) / kSectionAlignment *
+         kSectionAlignment;
+}
+
+/**
+ * @brief SourceStamp Size and modification time, in nanoseconds where the
+ * platform has them, of the file at filename.
+ */
+bool SourceStamp(const std::string &filename, uint64_t *size, int64_t *mtime) {
+#ifdef _WIN32
+  struct _stat64 info;
+  if (_stat64(filename.c_str(), &info) != 0) return false;
+  *mtime = static_cast<int64_t>(info.st_mtime) * 1000000000;
+#else
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) return false;
+#if defined(__APPLE__)
+  *mtime = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 +
+           info.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+  *mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+           info.st_mtim.tv_nsec;
+#else
+  *mtime = static_cast<int64_t>(info.st_mtime) * 1000000000;
+#endif
+#endif
+  *size = static_cast<uint64_t>(info.st_size);
+  return true;
+}
+
+/**
+ * @brief BuildInterleaved Position and normal of each vertex, one after the
+ * other.
+ */
+void BuildInterleaved(const TriangleMesh &mesh,
+                      std::vector<float> *interleaved) {
+  const size_t num_vertices = mesh.vertices_.size() / 3;
+  interleaved->resize(num_vertices * 6);
+  float *out = interleaved->data();
+  for (size_t v = 0; v < num_vertices; ++v) {
+    for (size_t c = 0; c < 3; ++c) {
+      out[6 * v + c] = mesh.vertices_[3 * v + c];
+      out[6 * v + 3 + c] = mesh.normals_[3 * v + c];
+    }
+  }
+}
+
+template <typename T>
+void CopySection(const char *data, uint64_t offset, uint64_t bytes,
+                 std::vector<T> *out) {
+  out->resize(bytes / sizeof(T));
+  if (bytes > 0) std::memcpy(out->data(), data + offset, bytes);
+}
+
+/**
+ * @brief UpdateSourceMtime Rewrites the source modification time in the
+ * header of cache_file, so that a source touched without being changed is
+ * trusted again without hashing it.
+ */
+bool UpdateSourceMtime(const std::string &cache_file, int64_t mtime) {
+  FILE *file = fopen(cache_file.c_str(), "r+b");
+  if (file == nullptr) return false;
+  bool ok = fseek(file, offsetof(CacheHeader, source_mtime), SEEK_SET) == 0 &&
+            fwrite(&mtime, sizeof(mtime), 1, file) == 1;
+  ok = (fclose(file) == 0) && ok;
+  return ok;
+}
+
+bool WriteSection(FILE *file, uint64_t *position, uint64_t offset,
+                  const void *data, uint64_t bytes) {
+  static const char kPadding[kSectionAlignment] = {};
+  if (offset > *position &&
+      fwrite(kPadding, 1, offset - *position, file) != offset - *position)
+    return false;
+  if (bytes > 0 && fwrite(data, 1, bytes, file) != bytes) return false;
+  *position = offset + bytes;
+  return true;
+}
+
+}  // namespace
+
+std::string MeshCacheFileName(const std::string &filename) {
+  const size_t dot = filename.find_last_of('.');
+  const size_t slash = filename.find_last_of("/\\");
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash))
+    return filename + ".mesh";
+  return filename.substr(0, dot) + ".mesh";
+}
+
+bool ReadFromCache(const std::string &cache_file,
+                   const std::string &source_file, TriangleMesh *mesh,
+                   std::vector<float> *interleaved) {
+  MappedFile file;
+  if (!file.Open(cache_file)) return false;
+  if (file.size() < sizeof(CacheHeader)) return false;
+
+  CacheHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kMeshCacheVersion ||
+      header.byte_order != kByteOrderMark)
+    return false;
+
+  // Every section must lie inside the file; bounding the counts first keeps
+  // the section sizes from overflowing.
+  const uint64_t file_size = file.size();
+  if (header.num_vertices > file_size / sizeof(float) ||
+      header.num_triangles > file_size / sizeof(int))
+    return false;
+  if (header.offsets[kVertices] == 0 || header.offsets[kFaces] == 0 ||
+      header.offsets[kNormals] == 0)
+    return false;
+  for (int s = 0; s < kNumSections; ++s) {
+    const uint64_t offset = header.offsets[s];
+    if (offset == 0) continue;
+    const uint64_t bytes = SectionBytes(static_cast<Section>(s),
+                                        header.num_vertices,
+                                        header.num_triangles);
+    if (offset < sizeof(CacheHeader) || offset % kSectionAlignment != 0 ||
+        offset > file_size || bytes > file_size - offset)
+      return false;
+  }
+
+  // The cache must have been written for the current source.
+  uint64_t source_size;
+  int64_t source_mtime;
+  if (!SourceStamp(source_file, &source_size, &source_mtime) ||
+      source_size != header.source_size)
+    return false;
+  const bool kTouched = source_mtime != header.source_mtime;
+  if (kTouched) {
+    uint64_t hash;
+    if (!HashFile(source_file, &hash) || hash != header.source_hash)
+      return false;
+  }
+
+  // A corrupt cache must not send indices out of the vertex buffer.
+  const int *faces =
+      reinterpret_cast<const int *>(file.data() + header.offsets[kFaces]);
+  for (uint64_t i = 0; i < header.num_triangles * 3; ++i) {
+    if (faces[i] < 0 || static_cast<uint64_t>(faces[i]) >= header.num_vertices)
+      return false;
+  }
+
+  const uint64_t n = header.num_vertices;
+  const uint64_t t = header.num_triangles;
+  mesh->Clear();
+  CopySection(file.data(), header.offsets[kVertices],
+              SectionBytes(kVertices, n, t), &mesh->vertices_);
+  CopySection(file.data(), header.offsets[kFaces], SectionBytes(kFaces, n, t),
+              &mesh->faces_);
+  CopySection(file.data(), header.offsets[kNormals],
+              SectionBytes(kNormals, n, t), &mesh->normals_);
+  if (header.offsets[kColors] != 0)
+    CopySection(file.data(), header.offsets[kColors],
+                SectionBytes(kColors, n, t), &mesh->colors_);
+  if (header.offsets[kTexcoords] != 0)
+    CopySection(file.data(), header.offsets[kTexcoords],
+                SectionBytes(kTexcoords, n, t), &mesh->texcoords_);
+  mesh->min_ = Eigen::Vector3f(header.min[0], header.min[1], header.min[2]);
+  mesh->max_ = Eigen::Vector3f(header.max[0], header.max[1], header.max[2]);
+
+  if (interleaved != nullptr) {
+    if (header.offsets[kInterleaved] != 0)
+      CopySection(file.data(), header.offsets[kInterleaved],
+                  SectionBytes(kInterleaved, n, t), interleaved);
+    else
+      BuildInterleaved(*mesh, interleaved);
+  }
+
+  // Same contents under a new mtime (touch, checkout, copy): record it, or
+  // every later start would hash the whole source again. Failing to is not
+  // an error.
+  file.Close();
+  if (kTouched) UpdateSourceMtime(cache_file, source_mtime);
+
+  return true;
+}
+
+bool WriteToCache(const std::string &cache_file, const std::string &source_file,
+                  const TriangleMesh &mesh, bool interleaved) {
+  const uint64_t n = mesh.vertices_.size() / 3;
+  const uint64_t t = mesh.faces_.size() / 3;
+  if (mesh.normals_.size() != n * 3) return false;
+  const bool has_colors = !mesh.colors_.empty() && mesh.colors_.size() == n * 3;
+  const bool has_texcoords =
+      !mesh.texcoords_.empty() && mesh.texcoords_.size() == n * 2;
+
+  CacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kMeshCacheVersion;
+  header.byte_order = kByteOrderMark;
+  if (!SourceStamp(source_file, &header.source_size, &header.source_mtime) ||
+      !HashFile(source_file, &header.source_hash))
+    return false;
+  header.num_vertices = n;
+  header.num_triangles = t;
+  for (int c = 0; c < 3; ++c) {
+    header.min[c] = mesh.min_[c];
+    header.max[c] = mesh.max_[c];
+  }
+
+  std::vector<float> buffer;
+  if (interleaved) BuildInterleaved(mesh, &buffer);
+
+  const void *sections[kNumSections] = {
+      mesh.vertices_.data(),
+      mesh.faces_.data(),
+      mesh.normals_.data(),
+      has_colors ? mesh.colors_.data() : nullptr,
+      has_texcoords ? mesh.texcoords_.data() : nullptr,
+      interleaved ? buffer.data() : nullptr};
+  const bool present[kNumSections] = {true, true, true, has_colors,
+                                      has_texcoords, interleaved};
+
+  uint64_t end = sizeof(CacheHeader);
+  for (int s = 0; s < kNumSections; ++s) {
+    if (!present[s]) continue;
+    header.offsets[s] = Align(end);
+    end = header.offsets[s] + SectionBytes(static_cast<Section>(s), n, t);
+  }
+
+  FILE *file = fopen(cache_file.c_str(), "wb");
+  if (file == nullptr) return false;
+
+  uint64_t position = 0;
+  bool ok = WriteSection(file, &position, 0, &header, sizeof(header));
+  for (int s = 0; ok && s < kNumSections; ++s) {
+    if (!present[s]) continue;
+    ok = WriteSection(file, &position, header.offsets[s], sections[s],
+                      SectionBytes(static_cast<Section>(s), n, t));
+  }
+  ok = (fclose(file) == 0) && ok;
+
+  // A partial cache would only be rejected on every start.
+  if (!ok) std::remove(cache_file.c_str());
+  return ok;
+}
+
+bool ReadFromPlyCached(const std::string &filename, TriangleMesh *mesh,
+                       std::vector<float> *interleaved, bool *from_cache) {
+  if (from_cache != nullptr) *from_cache = false;
+
+  const std::string cache_file = MeshCacheFileName(filename);
+  if (ReadFromCache(cache_file, filename, mesh, interleaved)) {
+    std::cout << "Loaded triangle mesh from " << cache_file << std::endl;
+    if (from_cache != nullptr) *from_cache = true;
+    return true;
+  }
+
+  if (!ReadFromPly(filename, mesh)) return false;
+  if (!WriteToCache(cache_file, filename, *mesh, interleaved != nullptr))
+    std::cerr << "Could not write the mesh cache " << cache_file << std::endl;
+  if (interleaved != nullptr) BuildInterleaved(*mesh, interleaved);
+
+  return true;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,78 @@
+// Author: Marc Comino 2020
+
+#ifndef MESH_CACHE_H_
+#define MESH_CACHE_H_
+
+#include <triangle_mesh.h>
+
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief kMeshCacheVersion Version of the mesh cache layout. Caches of any
+ * other version are ignored and written again.
+ *
+ * A cache holds a fixed 128-byte header followed by sections, each starting
+ * at a multiple of 64 bytes, in the byte order and float format of the host
+ * that wrote it:
+ *   header      "MSHC", version, byte order mark, the size, modification time
+ *               and FNV-1a hash of the source file, the vertex and triangle
+ *               counts, the bounding box and the byte offset of each section
+ *               (0 if absent)
+ *   vertices    float xyz per vertex
+ *   faces       int, three per triangle
+ *   normals     float xyz per vertex
+ *   colors      float rgb per vertex (optional)
+ *   texcoords   float uv per vertex (optional)
+ *   interleaved float xyz + normal xyz per vertex, ready for a vertex buffer
+ *               (optional)
+ */
+const unsigned int kMeshCacheVersion = 1;
+
+/**
+ * @brief MeshCacheFileName The cache of a model, next to it: models/teapot.ply
+ * is cached in models/teapot.mesh.
+ */
+std::string MeshCacheFileName(const std::string &filename);
+
+/**
+ * @brief ReadFromCache Maps the cache at cache_file and copies its sections
+ * into the mesh, with no parsing, if it was written for the current contents
+ * of source_file. A cache whose source has the same size and modification
+ * time is trusted as is; otherwise it is used only if the source still has
+ * the same hash.
+ * @param interleaved If not null, receives the interleaved buffer, built
+ * from the mesh if the cache has none.
+ * @return Whether the cache was valid and could be read.
+ */
+bool ReadFromCache(const std::string &cache_file,
+                   const std::string &source_file, TriangleMesh *mesh,
+                   std::vector<float> *interleaved = nullptr);
+
+/**
+ * @brief WriteToCache Stores the mesh at cache_file, tagged with the size,
+ * modification time and hash of source_file.
+ * @param interleaved Whether to store the interleaved buffer too.
+ * @return Whether the cache could be written.
+ */
+bool WriteToCache(const std::string &cache_file, const std::string &source_file,
+                  const TriangleMesh &mesh, bool interleaved);
+
+/**
+ * @brief ReadFromPlyCached ReadFromPly through the cache of filename: reads
+ * the cache if it is up to date, else reads the PLY file and writes the
+ * cache. Failing to write the cache is not an error.
+ * @param interleaved If not null, receives the interleaved buffer, which is
+ * then stored in the cache too.
+ * @param from_cache If not null, whether the mesh came from the cache.
+ * @return Whether the mesh could be read.
+ */
+bool ReadFromPlyCached(const std::string &filename, TriangleMesh *mesh,
+                       std::vector<float> *interleaved = nullptr,
+                       bool *from_cache = nullptr);
+
+}  // namespace data_representation
+
+#endif  // MESH_CACHE_H_
@@ -2,148 +2,991 @@
 
 #include <mesh_io.h>
 
-#include <assert.h>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 #include <algorithm>
-#include <fstream>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "./ThreadPool.h"
+#include "./mapped_file.h"
 #include "./triangle_mesh.h"
 
 namespace data_representation {
 
 namespace {
 
-template <typename T>
-void Add3Items(T i1, T i2, T i3, size_t index, std::vector<T> *vector) {
-  (*vector)[index] = i1;
-  (*vector)[index + 1] = i2;
-  (*vector)[index + 2] = i3;
+/**
+ * @brief The PlyType enum Scalar types of PLY properties, in the order of
+ * the spec: the integral ones first.
+ */
+enum class PlyType {
+  kInt8,
+  kUint8,
+  kInt16,
+  kUint16,
+  kInt32,
+  kUint32,
+  kFloat32,
+  kFloat64,
+  kInvalid
+};
+
+PlyType ParsePlyType(const std::string &name) {
+  if (name == "char" || name == "int8") return PlyType::kInt8;
+  if (name == "uchar" || name == "uint8") return PlyType::kUint8;
+  if (name == "short" || name == "int16") return PlyType::kInt16;
+  if (name == "ushort" || name == "uint16") return PlyType::kUint16;
+  if (name == "int" || name == "int32") return PlyType::kInt32;
+  if (name == "uint" || name == "uint32") return PlyType::kUint32;
+  if (name == "float" || name == "float32") return PlyType::kFloat32;
+  if (name == "double" || name == "float64") return PlyType::kFloat64;
+  return PlyType::kInvalid;
 }
 
-bool ReadPlyHeader(std::ifstream *fin, int *vertices, int *faces) {
-  char line[100];
+size_t PlyTypeSize(PlyType type) {
+  switch (type) {
+    case PlyType::kInt8:
+    case PlyType::kUint8:
+      return 1;
+    case PlyType::kInt16:
+    case PlyType::kUint16:
+      return 2;
+    case PlyType::kInt32:
+    case PlyType::kUint32:
+    case PlyType::kFloat32:
+      return 4;
+    case PlyType::kFloat64:
+      return 8;
+    default:
+      return 0;
+  }
+}
 
-  fin->getline(line, 100);
-  if (strncmp(line, "ply", 3) != 0) return false;
+bool IsIntegral(PlyType type) { return type < PlyType::kFloat32; }
 
-  *vertices = 0;
-  fin->getline(line, 100);
-  while (strncmp(line, "end_header", 10) != 0) {
-    if (strncmp(line, "element vertex", 14) == 0) *vertices = atoi(&line[15]);
-    fin->getline(line, 100);
-    if (strncmp(line, "element face", 12) == 0) *faces = atoi(&line[13]);
+/**
+ * @brief IntegralMax The largest value of an integral type, by which colors
+ * stored in it are divided to bring them to [0, 1].
+ */
+float IntegralMax(PlyType type) {
+  switch (type) {
+    case PlyType::kInt8:
+      return 127.0f;
+    case PlyType::kUint8:
+      return 255.0f;
+    case PlyType::kInt16:
+      return 32767.0f;
+    case PlyType::kUint16:
+      return 65535.0f;
+    case PlyType::kInt32:
+      return 2147483647.0f;
+    case PlyType::kUint32:
+      return 4294967295.0f;
+    default:
+      return 1.0f;
   }
+}
 
-  if (*vertices <= 0) return false;
+enum class PlyFormat { kAscii, kBinaryLittleEndian, kBinaryBigEndian };
 
-  std::cout << "Loading triangle mesh" << std::endl;
-  std::cout << "\tVertices = " << *vertices << std::endl;
-  std::cout << "\tFaces = " << *faces << std::endl;
+/**
+ * @brief The PlyProperty struct A property of a PLY element: a scalar, or a
+ * list of count_type length followed by that many scalars of type.
+ */
+struct PlyProperty {
+  std::string name;
+  PlyType type = PlyType::kInvalid;
+  bool is_list = false;
+  PlyType count_type = PlyType::kInvalid;
+};
+
+/**
+ * @brief The PlyElement struct An element of a PLY file: count records of
+ * the properties, in order.
+ */
+struct PlyElement {
+  std::string name;
+  size_t count = 0;
+  std::vector<PlyProperty> properties;
+
+  /**
+   * @brief Find The index of the property called name, -1 if there is none.
+   */
+  int Find(const std::string &property) const {
+    for (size_t i = 0; i < properties.size(); ++i)
+      if (properties[i].name == property) return static_cast<int>(i);
+    return -1;
+  }
+
+  /**
+   * @brief Stride Bytes of a binary record, 0 if its size varies because it
+   * holds lists.
+   */
+  size_t Stride() const {
+    size_t stride = 0;
+    for (const PlyProperty &property : properties) {
+      if (property.is_list) return 0;
+      stride += PlyTypeSize(property.type);
+    }
+    return stride;
+  }
+
+  /**
+   * @brief MinRecordSize Fewest bytes a record can take: lists empty, and in
+   * ascii a digit and a separator per value. Bounds the count a header can
+   * claim for the data that follows it.
+   */
+  size_t MinRecordSize(bool ascii) const {
+    size_t size = 0;
+    for (const PlyProperty &property : properties)
+      size += ascii ? 2 : PlyTypeSize(property.is_list ? property.count_type
+                                                       : property.type);
+    return size;
+  }
+
+  /**
+   * @brief Offset Byte offset of property i in a binary record, meaningful
+   * only if Stride() is not 0.
+   */
+  size_t Offset(int i) const {
+    size_t offset = 0;
+    for (int j = 0; j < i; ++j) offset += PlyTypeSize(properties[j].type);
+    return offset;
+  }
+};
+
+/**
+ * @brief The PlyHeader struct The schema of a PLY file, as declared by its
+ * header.
+ */
+struct PlyHeader {
+  PlyFormat format = PlyFormat::kAscii;
+  std::vector<PlyElement> elements;
+  size_t data_offset = 0;  // First byte after end_header.
+};
+
+/**
+ * @brief ParsePlyHeader Parses the header at the start of the size bytes at
+ * data into its schema, and checks that it describes a mesh: a vertex element
+ * with x, y and z, and optionally a face element with a vertex_indices list
+ * of integers.
+ * @return Whether the header is valid. If not, error says why.
+ */
+bool ParsePlyHeader(const char *data, size_t size, PlyHeader *header,
+                    std::string *error) {
+  bool has_format = false;
+
+  size_t pos = 0;
+  for (int line_number = 0; pos < size; ++line_number) {
+    const char *line_end =
+        static_cast<const char *>(memchr(data + pos, '\n', size - pos));
+    if (line_end == nullptr) break;
+    std::string line(data + pos, line_end);
+    pos = static_cast<size_t>(line_end - data) + 1;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+    if (line_number == 0) {
+      if (line != "ply") {
+        *error = "not a PLY file";
+        return false;
+      }
+      continue;
+    }
+
+    std::istringstream tokens(line);
+    std::string keyword;
+    tokens >> keyword;
+
+    if (keyword == "end_header") {
+      header->data_offset = pos;
+      break;
+    } else if (keyword == "comment" || keyword == "obj_info" ||
+               keyword.empty()) {
+      continue;
+    } else if (keyword == "format") {
+      std::string format, version;
+      tokens >> format >> version;
+      if (format == "ascii") {
+        header->format = PlyFormat::kAscii;
+      } else if (format == "binary_little_endian") {
+        header->format = PlyFormat::kBinaryLittleEndian;
+      } else if (format == "binary_big_endian") {
+        header->format = PlyFormat::kBinaryBigEndian;
+      } else {
+        *error = "unknown format '" + format + "'";
+        return false;
+      }
+      if (version != "1.0") {
+        *error = "unsupported PLY version '" + version + "'";
+        return false;
+      }
+      has_format = true;
+    } else if (keyword == "element") {
+      PlyElement element;
+      unsigned long long count = 0;  // NOLINT(runtime/int)
+      if (!(tokens >> element.name >> count)) {
+        *error = "malformed line '" + line + "'";
+        return false;
+      }
+      element.count = static_cast<size_t>(count);
+      header->elements.push_back(element);
+    } else if (keyword == "property") {
+      if (header->elements.empty()) {
+        *error = "property outside an element";
+        return false;
+      }
+      PlyProperty property;
+      std::string type;
+      tokens >> type;
+      if (type == "list") {
+        std::string count_type;
+        tokens >> count_type >> type;
+        property.is_list = true;
+        property.count_type = ParsePlyType(count_type);
+        if (!IsIntegral(property.count_type)) {
+          *error = "invalid list length type in '" + line + "'";
+          return false;
+        }
+      }
+      property.type = ParsePlyType(type);
+      if (!(tokens >> property.name) || property.type == PlyType::kInvalid) {
+        *error = "invalid property '" + line + "'";
+        return false;
+      }
+      header->elements.back().properties.push_back(property);
+    } else {
+      *error = "unknown header line '" + line + "'";
+      return false;
+    }
+  }
+
+  if (header->data_offset == 0) {
+    *error = "missing end_header";
+    return false;
+  }
+  if (!has_format) {
+    *error = "missing format";
+    return false;
+  }
+
+  const PlyElement *vertices = nullptr;
+  for (const PlyElement &element : header->elements) {
+    if (element.name == "vertex") {
+      vertices = &element;
+      for (const char *axis : {"x", "y", "z"}) {
+        int i = element.Find(axis);
+        if (i < 0 || element.properties[i].is_list) {
+          *error = std::string("vertices without a scalar ") + axis;
+          return false;
+        }
+      }
+    } else if (element.name == "face") {
+      int i = element.Find("vertex_indices");
+      if (i < 0) i = element.Find("vertex_index");
+      if (i < 0 || !element.properties[i].is_list ||
+          !IsIntegral(element.properties[i].type)) {
+        *error = "faces without a vertex_indices list of integers";
+        return false;
+      }
+    }
+  }
+  if (vertices == nullptr || vertices->count == 0 ||
+      vertices->count > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    *error = "unsupported number of vertices";
+    return false;
+  }
 
   return true;
 }
 
-void ReadPlyVertices(std::ifstream *fin, TriangleMesh *mesh) {
-  const size_t kVertices = mesh->vertices_.size() / 3;
-  for (size_t i = 0; i < kVertices; ++i) {
-    float x, y, z;
-    fin->read(reinterpret_cast<char *>(&x), sizeof(float));
-    fin->read(reinterpret_cast<char *>(&y), sizeof(float));
-    fin->read(reinterpret_cast<char *>(&z), sizeof(float));
+/**
+ * @brief Load Reads a T at data, reversing its bytes if swap.
+ */
+template <typename T>
+T Load(const char *data, bool swap) {
+  char bytes[sizeof(T)];
+  memcpy(bytes, data, sizeof(T));
+  if (swap) std::reverse(bytes, bytes + sizeof(T));
+  T value;
+  memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define MESH_IO_SSE2 1
+#endif
+
+#if defined(MESH_IO_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define MESH_IO_AVX2 1
+
+/**
+ * @brief SwapBytes32Avx2 Reverses the bytes of the first count words of
+ * bytes, 8 at a time, and returns how many it reversed.
+ */
+__attribute__((target("avx2"))) size_t SwapBytes32Avx2(char *bytes,
+                                                         size_t count) {
+  const __m256i kReverse = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,  // Low lane.
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);  // High lane.
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i *words = reinterpret_cast<__m256i *>(bytes + 4 * i);
+    _mm256_storeu_si256(
+        words, _mm256_shuffle_epi8(_mm256_loadu_si256(words), kReverse));
+  }
+  return i;
+}
+
+bool HasAvx2() {
+  static const bool kAvx2 = __builtin_cpu_supports("avx2");
+  return kAvx2;
+}
+#endif
+
+/**
+ * @brief SwapBytes32 Reverses the bytes of each of the count 32-bit words at
+ * data: 8 words per instruction with AVX2 where the CPU has it, 4 with SSE2.
+ */
+void SwapBytes32(void *data, size_t count) {
+  char *bytes = static_cast<char *>(data);
+  size_t i = 0;
+
+#ifdef MESH_IO_AVX2
+  if (HasAvx2()) i = SwapBytes32Avx2(bytes, count);
+#endif
+
+#ifdef MESH_IO_SSE2
+  // SSE2 has no byte shuffle: swap the 16-bit halves of each word, then the
+  // bytes of each half.
+  for (; i + 4 <= count; i += 4) {
+    __m128i *words = reinterpret_cast<__m128i *>(bytes + 4 * i);
+    __m128i x = _mm_loadu_si128(words);
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    _mm_storeu_si128(words, x);
+  }
+#endif
 
-    Add3Items(x, y, z, i * 3, &(mesh->vertices_));
+  for (; i < count; ++i) {
+    char *word = bytes + 4 * i;
+    std::swap(word[0], word[3]);
+    std::swap(word[1], word[2]);
   }
 }
 
-void ReadPlyFaces(std::ifstream *fin, TriangleMesh *mesh) {
-  unsigned char vertex_per_face;
+/**
+ * @brief The PlyCursor class Reads the data section of a PLY file one scalar
+ * at a time, in any of the three formats. A read past the end fails.
+ */
+class PlyCursor {
+ public:
+  PlyCursor(const char *begin, const char *end, PlyFormat format)
+      : position_(begin),
+        end_(end),
+        ascii_(format == PlyFormat::kAscii),
+        swap_(!ascii_ &&
+              (format == PlyFormat::kBinaryBigEndian) != HostIsBigEndian()) {}
+
+  bool ascii() const { return ascii_; }
+  bool swap() const { return swap_; }
+  const char *position() const { return position_; }
+  size_t remaining() const { return static_cast<size_t>(end_ - position_); }
+
+  /**
+   * @brief Advance Skips bytes bytes of binary data.
+   * @return Whether there were that many left.
+   */
+  bool Advance(size_t bytes) {
+    if (remaining() < bytes) return false;
+    position_ += bytes;
+    return true;
+  }
+
+  /**
+   * @brief Read Reads the next scalar, of type type.
+   */
+  bool Read(PlyType type, double *value) {
+    if (ascii_) return ReadAscii(value);
+
+    const size_t kSize = PlyTypeSize(type);
+    if (remaining() < kSize) return false;
+    switch (type) {
+      case PlyType::kInt8:
+        *value = Load<int8_t>(position_, swap_);
+        break;
+      case PlyType::kUint8:
+        *value = Load<uint8_t>(position_, swap_);
+        break;
+      case PlyType::kInt16:
+        *value = Load<int16_t>(position_, swap_);
+        break;
+      case PlyType::kUint16:
+        *value = Load<uint16_t>(position_, swap_);
+        break;
+      case PlyType::kInt32:
+        *value = Load<int32_t>(position_, swap_);
+        break;
+      case PlyType::kUint32:
+        *value = Load<uint32_t>(position_, swap_);
+        break;
+      case PlyType::kFloat32:
+        *value = Load<float>(position_, swap_);
+        break;
+      default:
+        *value = Load<double>(position_, swap_);
+        break;
+    }
+    position_ += kSize;
+    return true;
+  }
+
+  /**
+   * @brief Skip Skips the next value of property, all of it for a list.
+   */
+  bool Skip(const PlyProperty &property) {
+    double value;
+    if (!property.is_list) return Read(property.type, &value);
+    if (!Read(property.count_type, &value) || value < 0 ||
+        value > static_cast<double>(remaining()))
+      return false;
+    const size_t kCount = static_cast<size_t>(value);
+    if (!ascii_) return Advance(kCount * PlyTypeSize(property.type));
+    for (size_t i = 0; i < kCount; ++i)
+      if (!ReadAscii(&value)) return false;
+    return true;
+  }
+
+ private:
+  // Numbers are whitespace separated; line breaks carry no meaning.
+  bool ReadAscii(double *value) {
+    while (position_ < end_ && isspace(static_cast<unsigned char>(*position_)))
+      ++position_;
+    const char *token = position_;
+    while (position_ < end_ &&
+           !isspace(static_cast<unsigned char>(*position_)))
+      ++position_;
+
+    // The mapping is not null terminated: parse a copy.
+    char buffer[64];
+    const size_t kLength = static_cast<size_t>(position_ - token);
+    if (kLength == 0 || kLength >= sizeof(buffer)) return false;
+    memcpy(buffer, token, kLength);
+    buffer[kLength] = '\0';
+
+    char *parsed;
+    *value = strtod(buffer, &parsed);
+    return parsed == buffer + kLength;
+  }
+
+  const char *position_;
+  const char *end_;
+  bool ascii_;
+  bool swap_;
+};
+
+/**
+ * @brief The VertexAttribute struct A per-vertex array of the mesh and the
+ * vertex properties that fill each of its width components.
+ */
+struct VertexAttribute {
+  std::vector<float> *array = nullptr;
+  int width = 0;
+  int properties[3] = {-1, -1, -1};
+  bool normalized = false;  // Integers are scaled to [0, 1].
+};
+
+/**
+ * @brief FindAttribute Looks for the first of the spellings of an attribute,
+ * each a list of width property names, present in full in element.
+ */
+bool FindAttribute(const PlyElement &element,
+                   const std::vector<std::vector<std::string>> &spellings,
+                   VertexAttribute *attribute) {
+  for (const std::vector<std::string> &names : spellings) {
+    bool found = true;
+    for (int j = 0; j < attribute->width; ++j) {
+      attribute->properties[j] = element.Find(names[j]);
+      found = found && attribute->properties[j] >= 0 &&
+              !element.properties[attribute->properties[j]].is_list;
+    }
+    if (found) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief VertexAttributes The attributes of the mesh the vertex element
+ * provides: always the positions, and the normals, colors and texture
+ * coordinates if present.
+ */
+std::vector<VertexAttribute> VertexAttributes(const PlyElement &element,
+                                              TriangleMesh *mesh) {
+  std::vector<VertexAttribute> attributes;
+  VertexAttribute attribute;
+
+  attribute.array = &mesh->vertices_;
+  attribute.width = 3;
+  FindAttribute(element, {{"x", "y", "z"}}, &attribute);
+  attributes.push_back(attribute);
+
+  attribute.array = &mesh->normals_;
+  if (FindAttribute(element, {{"nx", "ny", "nz"}}, &attribute))
+    attributes.push_back(attribute);
+
+  attribute.array = &mesh->colors_;
+  attribute.normalized = true;
+  if (FindAttribute(element,
+                    {{"red", "green", "blue"},
+                     {"r", "g", "b"},
+                     {"diffuse_red", "diffuse_green", "diffuse_blue"}},
+                    &attribute))
+    attributes.push_back(attribute);
+
+  attribute.array = &mesh->texcoords_;
+  attribute.width = 2;
+  attribute.normalized = false;
+  if (FindAttribute(element,
+                    {{"u", "v"},
+                     {"s", "t"},
+                     {"texture_u", "texture_v"},
+                     {"texture_s", "texture_t"}},
+                    &attribute))
+    attributes.push_back(attribute);
+
+  return attributes;
+}
+
+/**
+ * @brief GatherScalars Converts count scalars of type T, stride bytes apart
+ * from data, to floats stored out_stride apart from out.
+ */
+template <typename T>
+void GatherScalars(const char *data, size_t stride, size_t count, bool swap,
+                   float scale, float *out, size_t out_stride) {
+  for (size_t i = 0; i < count; ++i)
+    out[i * out_stride] =
+        static_cast<float>(Load<T>(data + i * stride, swap)) * scale;
+}
+
+void GatherProperty(PlyType type, const char *data, size_t stride,
+                    size_t count, bool swap, float scale, float *out,
+                    size_t out_stride) {
+  switch (type) {
+    case PlyType::kInt8:
+      GatherScalars<int8_t>(data, stride, count, swap, scale, out, out_stride);
+      break;
+    case PlyType::kUint8:
+      GatherScalars<uint8_t>(data, stride, count, swap, scale, out,
+                             out_stride);
+      break;
+    case PlyType::kInt16:
+      GatherScalars<int16_t>(data, stride, count, swap, scale, out,
+                             out_stride);
+      break;
+    case PlyType::kUint16:
+      GatherScalars<uint16_t>(data, stride, count, swap, scale, out,
+                              out_stride);
+      break;
+    case PlyType::kInt32:
+      GatherScalars<int32_t>(data, stride, count, swap, scale, out,
+                             out_stride);
+      break;
+    case PlyType::kUint32:
+      GatherScalars<uint32_t>(data, stride, count, swap, scale, out,
+                              out_stride);
+      break;
+    case PlyType::kFloat32:
+      GatherScalars<float>(data, stride, count, swap, scale, out, out_stride);
+      break;
+    default:
+      GatherScalars<double>(data, stride, count, swap, scale, out,
+                            out_stride);
+      break;
+  }
+}
+
+/**
+ * @brief ReadBinaryVertices Reads fixed-size binary vertex records. An
+ * attribute stored as consecutive floats is copied record by record, or in a
+ * single memcpy if the records hold nothing else, and then byte swapped in
+ * bulk if needed; any other one is converted property by property.
+ */
+bool ReadBinaryVertices(const PlyElement &element,
+                        const std::vector<VertexAttribute> &attributes,
+                        PlyCursor *cursor) {
+  const size_t kCount = element.count;
+  const size_t kStride = element.Stride();
+  if (cursor->remaining() / kStride < kCount) return false;
+  const char *data = cursor->position();
+
+  for (const VertexAttribute &attribute : attributes) {
+    float *out = attribute.array->data();
+    const size_t kWidth = static_cast<size_t>(attribute.width);
+    const size_t kOffset = element.Offset(attribute.properties[0]);
+
+    bool packed = true;
+    for (size_t j = 0; j < kWidth; ++j) {
+      const int kProperty = attribute.properties[j];
+      packed = packed &&
+               element.properties[kProperty].type == PlyType::kFloat32 &&
+               element.Offset(kProperty) == kOffset + j * sizeof(float);
+    }
+
+    if (packed) {
+      const size_t kBytes = kWidth * sizeof(float);
+      if (kStride == kBytes) {
+        memcpy(out, data, kCount * kBytes);
+      } else {
+        for (size_t i = 0; i < kCount; ++i)
+          memcpy(out + i * kWidth, data + i * kStride + kOffset, kBytes);
+      }
+      if (cursor->swap()) SwapBytes32(out, kCount * kWidth);
+      continue;
+    }
+
+    for (size_t j = 0; j < kWidth; ++j) {
+      const int kProperty = attribute.properties[j];
+      const PlyType kType = element.properties[kProperty].type;
+      const float kScale =
+          attribute.normalized && IsIntegral(kType) ? 1.0f / IntegralMax(kType)
+                                                    : 1.0f;
+      GatherProperty(kType, data + element.Offset(kProperty), kStride, kCount,
+                     cursor->swap(), kScale, out + j, kWidth);
+    }
+  }
+
+  return cursor->Advance(kCount * kStride);
+}
 
-  const size_t kFaces = mesh->faces_.size() / 3;
+/**
+ * @brief ReadVertices Reads the vertex element into the per-vertex arrays of
+ * the mesh: in bulk for fixed-size binary records, value by value otherwise.
+ */
+bool ReadVertices(const PlyElement &element, PlyCursor *cursor,
+                  TriangleMesh *mesh, std::string *error) {
+  const std::vector<VertexAttribute> kAttributes =
+      VertexAttributes(element, mesh);
+  for (const VertexAttribute &attribute : kAttributes)
+    attribute.array->resize(element.count * attribute.width);
+
+  if (!cursor->ascii() && element.Stride() > 0) {
+    if (!ReadBinaryVertices(element, kAttributes, cursor)) {
+      *error = "truncated vertex data";
+      return false;
+    }
+    return true;
+  }
+
+  // Where each property goes: array, component and scale.
+  struct Target {
+    std::vector<float> *array = nullptr;
+    int width = 0;
+    int component = 0;
+    float scale = 1.0f;
+  };
+  std::vector<Target> targets(element.properties.size());
+  for (const VertexAttribute &attribute : kAttributes) {
+    for (int j = 0; j < attribute.width; ++j) {
+      Target &target = targets[attribute.properties[j]];
+      const PlyType kType = element.properties[attribute.properties[j]].type;
+      target.array = attribute.array;
+      target.width = attribute.width;
+      target.component = j;
+      if (attribute.normalized && IsIntegral(kType))
+        target.scale = 1.0f / IntegralMax(kType);
+    }
+  }
+
+  for (size_t i = 0; i < element.count; ++i) {
+    for (size_t p = 0; p < element.properties.size(); ++p) {
+      const Target &target = targets[p];
+      double value;
+      bool ok = target.array == nullptr
+                    ? cursor->Skip(element.properties[p])
+                    : cursor->Read(element.properties[p].type, &value);
+      if (!ok) {
+        *error = "invalid data in vertex " + std::to_string(i);
+        return false;
+      }
+      if (target.array != nullptr)
+        (*target.array)[i * target.width + target.component] =
+            static_cast<float>(value) * target.scale;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief GatherTriangles Copies the indices of the faces at data, records of
+ * a Count length followed by three 4-byte indices, into faces.
+ * @return The index of the first face that is not a triangle, or kFaces if
+ * all of them are.
+ */
+template <typename Count>
+size_t GatherTriangles(const char *data, size_t kFaces, bool swap,
+                       int *faces) {
+  const size_t kStride = sizeof(Count) + 3 * sizeof(int);
   for (size_t i = 0; i < kFaces; ++i) {
-    int v1, v2, v3;
-    fin->read(reinterpret_cast<char *>(&vertex_per_face),
-              sizeof(unsigned char));
-    assert(vertex_per_face == 3);
+    const char *record = data + i * kStride;
+    if (Load<Count>(record, swap) != 3) return i;
+    memcpy(&faces[i * 3], record + sizeof(Count), 3 * sizeof(int));
+  }
+  return kFaces;
+}
 
-    fin->read(reinterpret_cast<char *>(&v1), sizeof(int));
-    fin->read(reinterpret_cast<char *>(&v2), sizeof(int));
-    fin->read(reinterpret_cast<char *>(&v3), sizeof(int));
-    Add3Items(v1, v2, v3, i * 3, &(mesh->faces_));
+/**
+ * @brief GatherBinaryTriangles Reads the leading run of triangles of a face
+ * element made of just its 4-byte index list, straight from the binary
+ * records, and byte swaps the indices in bulk if needed.
+ * @return How many faces it read.
+ */
+size_t GatherBinaryTriangles(const PlyElement &element,
+                             const PlyProperty &indices, PlyCursor *cursor,
+                             TriangleMesh *mesh) {
+  const size_t kFaces = element.count;
+  const size_t kStride = PlyTypeSize(indices.count_type) + 3 * sizeof(int);
+  const size_t kAvailable = std::min(kFaces, cursor->remaining() / kStride);
+
+  mesh->faces_.resize(kAvailable * 3);
+  int *faces = mesh->faces_.data();
+  const char *data = cursor->position();
+  size_t read = 0;
+  switch (PlyTypeSize(indices.count_type)) {
+    case 1:
+      read = GatherTriangles<uint8_t>(data, kAvailable, cursor->swap(), faces);
+      break;
+    case 2:
+      read =
+          GatherTriangles<uint16_t>(data, kAvailable, cursor->swap(), faces);
+      break;
+    default:
+      read =
+          GatherTriangles<uint32_t>(data, kAvailable, cursor->swap(), faces);
+      break;
   }
+
+  mesh->faces_.resize(read * 3);
+  if (cursor->swap()) SwapBytes32(mesh->faces_.data(), read * 3);
+  cursor->Advance(read * kStride);
+  return read;
 }
 
-void ComputeVertexNormals(const std::vector<float> &vertices,
-                          const std::vector<int> &faces,
-                          std::vector<float> *normals) {
-  const size_t kFaces = faces.size();
-  std::vector<float> face_normals(kFaces, 0);
-
-  for (size_t i = 0; i < kFaces; i += 3) {
-    Eigen::Vector3d v1(vertices[faces[i] * 3], vertices[faces[i] * 3 + 1],
-                       vertices[faces[i] * 3 + 2]);
-    Eigen::Vector3d v2(vertices[faces[i + 1] * 3],
-                       vertices[faces[i + 1] * 3 + 1],
-                       vertices[faces[i + 1] * 3 + 2]);
-    Eigen::Vector3d v3(vertices[faces[i + 2] * 3],
-                       vertices[faces[i + 2] * 3 + 1],
-                       vertices[faces[i + 2] * 3 + 2]);
-    Eigen::Vector3d v1v2 = v2 - v1;
-    Eigen::Vector3d v1v3 = v3 - v1;
-    Eigen::Vector3d normal = v1v2.cross(v1v3);
-
-    if (normal.norm() < 0.00001) {
-      normal = Eigen::Vector3d(0.0, 0.0, 0.0);
-    } else {
-      normal.normalize();
-    }
-
-    for (size_t j = 0; j < 3; ++j) face_normals[i + j] = normal[j];
-  }
-
-  const size_t kVertices = vertices.size();
-  normals->resize(kVertices, 0);
-  for (size_t i = 0; i < kFaces; i += 3) {
-    for (size_t j = 0; j < 3; ++j) {
-      size_t idx = static_cast<size_t>(faces[i + j]);
-      Eigen::Vector3d v1(vertices[faces[i + j] * 3],
-                         vertices[faces[i + j] * 3 + 1],
-                         vertices[faces[i + j] * 3 + 2]);
-      Eigen::Vector3d v2(vertices[faces[i + (j + 1) % 3] * 3],
-                         vertices[faces[i + (j + 1) % 3] * 3 + 1],
-                         vertices[faces[i + (j + 1) % 3] * 3 + 2]);
-      Eigen::Vector3d v3(vertices[faces[i + (j + 2) % 3] * 3],
-                         vertices[faces[i + (j + 2) % 3] * 3 + 1],
-                         vertices[faces[i + (j + 2) % 3] * 3 + 2]);
-
-      Eigen::Vector3d v1v2 = v2 - v1;
-      Eigen::Vector3d v1v3 = v3 - v1;
-      double angle = acos(v1v2.dot(v1v3) / (v1v2.norm() * v1v3.norm()));
-
-      if (angle == angle) {
-        for (size_t k = 0; k < 3; ++k) {
-          (*normals)[idx * 3 + k] += face_normals[i + k] * angle;
+/**
+ * @brief ReadFaces Reads the face element into the triangles of the mesh,
+ * splitting polygons in fans around their first vertex. Faces of fewer than
+ * three vertices are dropped.
+ */
+bool ReadFaces(const PlyElement &element, PlyCursor *cursor,
+               TriangleMesh *mesh, std::string *error) {
+  int list = element.Find("vertex_indices");
+  if (list < 0) list = element.Find("vertex_index");
+  const PlyProperty &indices = element.properties[list];
+
+  size_t first = 0;
+  if (!cursor->ascii() && element.properties.size() == 1 &&
+      PlyTypeSize(indices.type) == sizeof(int))
+    first = GatherBinaryTriangles(element, indices, cursor, mesh);
+
+  // A face makes at least a triangle, but only as many as the data can hold.
+  const size_t kTriangleSize =
+      element.MinRecordSize(cursor->ascii()) +
+      3 * (cursor->ascii() ? 2 : PlyTypeSize(indices.type));
+  const size_t kTriangles =
+      std::min(element.count - first, cursor->remaining() / kTriangleSize);
+  mesh->faces_.reserve(mesh->faces_.size() + kTriangles * 3);
+  std::vector<int> polygon;
+  for (size_t i = first; i < element.count; ++i) {
+    for (size_t p = 0; p < element.properties.size(); ++p) {
+      bool ok = true;
+      if (static_cast<int>(p) != list) {
+        ok = cursor->Skip(element.properties[p]);
+      } else {
+        double count;
+        // Every index takes at least a byte: this bounds bogus lengths.
+        ok = cursor->Read(indices.count_type, &count) && count >= 0 &&
+             count <= static_cast<double>(cursor->remaining());
+        polygon.resize(ok ? static_cast<size_t>(count) : 0);
+        for (size_t k = 0; ok && k < polygon.size(); ++k) {
+          double index = 0;
+          ok = cursor->Read(indices.type, &index);
+          polygon[k] = static_cast<int>(index);
+        }
+        for (size_t k = 1; ok && k + 1 < polygon.size(); ++k) {
+          mesh->faces_.push_back(polygon[0]);
+          mesh->faces_.push_back(polygon[k]);
+          mesh->faces_.push_back(polygon[k + 1]);
         }
       }
+      if (!ok) {
+        *error = "invalid data in face " + std::to_string(i);
+        return false;
+      }
     }
   }
 
-  const size_t kNormals = normals->size();
-  for (size_t i = 0; i < kNormals; i += 3) {
-    Eigen::Vector3d normal((*normals)[i], (*normals)[i + 1], (*normals)[i + 2]);
-    if (normal.norm() > 0) {
-      normal.normalize();
-    } else {
-      normal = Eigen::Vector3d(0, 0, 0);
+  return true;
+}
+
+/**
+ * @brief SkipElement Moves the cursor past an element the mesh does not use.
+ */
+bool SkipElement(const PlyElement &element, PlyCursor *cursor) {
+  const size_t kStride = element.Stride();
+  if (!cursor->ascii() && kStride > 0) {
+    if (cursor->remaining() / kStride < element.count) return false;
+    return cursor->Advance(element.count * kStride);
+  }
+  for (size_t i = 0; i < element.count; ++i)
+    for (const PlyProperty &property : element.properties)
+      if (!cursor->Skip(property)) return false;
+  return true;
+}
+
+/**
+ * @brief ReadPlyData Reads the data section of a file with the given header
+ * into the mesh, and checks that the faces reference existing vertices.
+ */
+bool ReadPlyData(const PlyHeader &header, const char *begin, const char *end,
+                 TriangleMesh *mesh, std::string *error) {
+  PlyCursor cursor(begin, end, header.format);
+  size_t vertices = 0;
+  for (const PlyElement &element : header.elements) {
+    // The counts come from the header: the data must be able to hold them
+    // before anything is allocated for them. The last ascii value may end
+    // the file without a separator.
+    const size_t kRecordSize = element.MinRecordSize(cursor.ascii());
+    const size_t kSlack = cursor.ascii() ? 1 : 0;
+    if (kRecordSize > 0 &&
+        element.count > (cursor.remaining() + kSlack) / kRecordSize) {
+      *error = "truncated " + element.name + " data";
+      return false;
     }
 
-    for (size_t j = 0; j < 3; ++j) (*normals)[i + j] = normal[j];
+    bool ok = true;
+    if (element.name == "vertex") {
+      ok = ReadVertices(element, &cursor, mesh, error);
+      vertices = element.count;
+    } else if (element.name == "face") {
+      ok = ReadFaces(element, &cursor, mesh, error);
+    } else if (!SkipElement(element, &cursor)) {
+      *error = "truncated " + element.name + " data";
+      ok = false;
+    }
+    if (!ok) return false;
+  }
+
+  // Negative indices wrap to large unsigned ones.
+  unsigned int max_index = 0;
+  for (int index : mesh->faces_)
+    max_index = std::max(max_index, static_cast<unsigned int>(index));
+  if (!mesh->faces_.empty() && max_index >= vertices) {
+    *error = "face indices out of range";
+    return false;
+  }
+
+  return true;
+}
+
+// Faces per chunk of the face pass, vertices per chunk of the gather.
+const int kNormalsGrain = 16384;
+
+// Below this many faces ReadFromPly computes the normals on its own thread.
+const size_t kParallelNormalsFaces = 65536;
+
+void ParallelFor(ThreadPool *pool, int begin, int end,
+                 const std::function<void(int, int)> &fn) {
+  if (end <= begin) return;
+  if (pool != nullptr) {
+    pool->parallelFor(begin, end, kNormalsGrain, fn);
+  } else {
+    fn(begin, end);
   }
 }
 
-void ComputeBoundingBox(const std::vector<float> vertices, TriangleMesh *mesh) {
+/**
+ * @brief AcosPolynomial acos(x) for x in [0, 1] is sqrt(1 - x) times this
+ * polynomial, to 2e-8 (Abramowitz and Stegun 4.4.46).
+ */
+const float kAcos[8] = {1.5707963050f,  -0.2145988016f, 0.0889789874f,
+                        -0.0501743046f, 0.0308918810f,  -0.0170881256f,
+                        0.0066700901f,  -0.0012624911f};
+const float kPi = 3.14159265358979f;
+
+/**
+ * @brief CosinesToAngles Replaces each of the count cosines at values by its
+ * angle, 4 at a time with SSE2, and by 0 when it is not a cosine (a
+ * degenerate corner). The scalar tail evaluates the same polynomial.
+ */
+void CosinesToAngles(float *values, size_t count) {
+  size_t i = 0;
+
+#ifdef MESH_IO_SSE2
+  const __m128 kOne = _mm_set1_ps(1.0f);
+  const __m128 kSign = _mm_set1_ps(-0.0f);
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(values + i);
+    __m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+    __m128 a = _mm_andnot_ps(kSign, x);  // |x|
+    __m128 p = _mm_set1_ps(kAcos[7]);
+    for (int k = 6; k >= 0; --k)
+      p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(kAcos[k]));
+    // NaN for |x| > 1 and for NaN.
+    __m128 angle = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(kOne, a)), p);
+    angle = _mm_or_ps(_mm_and_ps(negative, _mm_sub_ps(_mm_set1_ps(kPi), angle)),
+                      _mm_andnot_ps(negative, angle));
+    angle = _mm_and_ps(angle, _mm_cmpord_ps(angle, angle));
+    _mm_storeu_ps(values + i, angle);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    const float kX = values[i];
+    const float kA = std::fabs(kX);
+    float p = kAcos[7];
+    for (int k = 6; k >= 0; --k) p = p * kA + kAcos[k];
+    float angle = std::sqrt(1.0f - kA) * p;
+    if (kX < 0) angle = kPi - angle;
+    values[i] = angle == angle ? angle : 0.0f;
+  }
+}
+
+/**
+ * @brief BuildVertexCorners The corners around each vertex as a CSR: the
+ * corners (3 * face + j) of vertex v are corners[offsets[v] .. offsets[v+1]),
+ * in increasing order. A counting sort of the corners by vertex.
+ */
+void BuildVertexCorners(size_t num_vertices, const std::vector<int> &faces,
+                        std::vector<int> *offsets, std::vector<int> *corners) {
+  offsets->assign(num_vertices + 1, 0);
+  for (int v : faces) ++(*offsets)[v + 1];
+  for (size_t v = 0; v < num_vertices; ++v) (*offsets)[v + 1] += (*offsets)[v];
+
+  // offsets[v] is used as the cursor of v, which leaves it at offsets[v+1].
+  corners->resize(faces.size());
+  for (size_t c = 0; c < faces.size(); ++c)
+    (*corners)[(*offsets)[faces[c]]++] = static_cast<int>(c);
+  for (size_t v = num_vertices; v > 0; --v) (*offsets)[v] = (*offsets)[v - 1];
+  (*offsets)[0] = 0;
+}
+
+void ComputeBoundingBox(const std::vector<float> &vertices,
+                        TriangleMesh *mesh) {
   const size_t kVertices = vertices.size() / 3;
   for (size_t i = 0; i < kVertices; ++i) {
     mesh->min_[0] = std::min(mesh->min_[0], vertices[i * 3]);
@@ -156,45 +999,244 @@ void ComputeBoundingBox(const std::vector<float> vertices, TriangleMesh *mesh) {
   }
 }
 
+/**
+ * @brief The BlockWriter class Buffered binary output: data is assembled in
+ * a large block that goes to the file in a single fwrite once full.
+ */
+class BlockWriter {
+ public:
+  static const size_t kBlockBytes = 4 << 20;
+
+  explicit BlockWriter(FILE *file) : file_(file), used_(0), ok_(true) {
+    block_.resize(kBlockBytes);
+  }
+
+  template <typename T>
+  void Put(T value) {
+    if (kBlockBytes - used_ < sizeof(T)) Flush();
+    memcpy(&block_[used_], &value, sizeof(T));
+    used_ += sizeof(T);
+  }
+
+  void Write(const void *data, size_t bytes) {
+    if (kBlockBytes - used_ < bytes) Flush();
+    // Payloads larger than a block skip it.
+    if (bytes >= kBlockBytes) {
+      ok_ = ok_ && fwrite(data, 1, bytes, file_) == bytes;
+      return;
+    }
+    memcpy(&block_[used_], data, bytes);
+    used_ += bytes;
+  }
+
+  /**
+   * @brief Flush Writes the block out.
+   * @return Whether every write so far succeeded.
+   */
+  bool Flush() {
+    if (used_ > 0) ok_ = ok_ && fwrite(block_.data(), 1, used_, file_) == used_;
+    used_ = 0;
+    return ok_;
+  }
+
+ private:
+  FILE *file_;
+  std::vector<char> block_;
+  size_t used_;
+  bool ok_;
+};
+
+/**
+ * @brief ToByte A color component in [0, 1] as an uchar.
+ */
+unsigned char ToByte(float value) {
+  return static_cast<unsigned char>(
+      std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
 }  // namespace
 
-bool ReadFromPly(const std::string &filename, TriangleMesh *mesh) {
-  std::ifstream fin;
+bool HostIsBigEndian() {
+  const uint32_t kOne = 1;
+  unsigned char first;
+  memcpy(&first, &kOne, 1);
+  return first == 0;
+}
+
+void ComputeVertexNormals(const std::vector<float> &vertices,
+                          const std::vector<int> &faces,
+                          std::vector<float> *normals,
+                          NormalWeighting weighting, ThreadPool *pool) {
+  typedef Eigen::Map<const Eigen::Vector3f> Point;
+  const int kFaces = static_cast<int>(faces.size() / 3);
+  const size_t kVertices = vertices.size() / 3;
+  const bool kByAngle = weighting == NormalWeighting::kAngle;
+
+  // Point clouds: no face, no normal.
+  if (faces.empty()) {
+    normals->assign(vertices.size(), 0.0f);
+    return;
+  }
+
+  // Face pass. By angle: unit face normals and the angle of each corner. By
+  // area: the cross products, whose length is twice the area.
+  std::vector<float> face_normals(faces.size());
+  std::vector<float> corner_angles(kByAngle ? faces.size() : 0);
+  ParallelFor(pool, 0, kFaces, [&](int begin, int end) {
+    for (int f = begin; f < end; ++f) {
+      const int *corner = &faces[3 * f];
+      Point p[3] = {Point(&vertices[3 * corner[0]]),
+                    Point(&vertices[3 * corner[1]]),
+                    Point(&vertices[3 * corner[2]])};
+      Eigen::Vector3f normal = (p[1] - p[0]).cross(p[2] - p[0]);
+
+      if (kByAngle) {
+        const float kLength = normal.norm();
+        normal = kLength < 0.00001f ? Eigen::Vector3f::Zero()
+                                    : Eigen::Vector3f(normal / kLength);
+        // The cosines; they become angles in bulk below.
+        for (int j = 0; j < 3; ++j) {
+          Eigen::Vector3f e1 = p[(j + 1) % 3] - p[j];
+          Eigen::Vector3f e2 = p[(j + 2) % 3] - p[j];
+          corner_angles[3 * f + j] = e1.dot(e2) / (e1.norm() * e2.norm());
+        }
+      }
+
+      for (int j = 0; j < 3; ++j) face_normals[3 * f + j] = normal[j];
+    }
+
+    // Degenerate corners get a weight of 0.
+    if (kByAngle)
+      CosinesToAngles(corner_angles.data() + 3 * begin, 3 * (end - begin));
+  });
 
-  fin.open(filename.c_str(), std::ios_base::in | std::ios_base::binary);
-  if (!fin.is_open() || !fin.good()) return false;
+  std::vector<int> offsets, corners;
+  BuildVertexCorners(kVertices, faces, &offsets, &corners);
+
+  // Vertex pass: each vertex gathers the faces around it and writes only its
+  // own normal, so the threads never share an output.
+  normals->assign(vertices.size(), 0.0f);
+  ParallelFor(pool, 0, static_cast<int>(kVertices), [&](int begin, int end) {
+    for (int v = begin; v < end; ++v) {
+      Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+      for (int k = offsets[v]; k < offsets[v + 1]; ++k) {
+        const int kCorner = corners[k];
+        const float kWeight = kByAngle ? corner_angles[kCorner] : 1.0f;
+        normal += kWeight * Point(&face_normals[3 * (kCorner / 3)]);
+      }
+
+      const float kLength = normal.norm();
+      if (kLength > 0) normal /= kLength;
+      for (int j = 0; j < 3; ++j) (*normals)[3 * v + j] = normal[j];
+    }
+  });
+}
 
-  int vertices = 0, faces = 0;
-  if (!ReadPlyHeader(&fin, &vertices, &faces)) {
-    fin.close();
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 NormalWeighting weighting) {
+  MappedFile file;
+  if (!file.Open(filename)) return false;
+
+  PlyHeader header;
+  std::string error;
+  if (!ParsePlyHeader(file.data(), file.size(), &header, &error)) {
+    std::cerr << filename << ": " << error << std::endl;
     return false;
   }
 
-  mesh->vertices_.resize(static_cast<size_t>(vertices) * 3);
-  ReadPlyVertices(&fin, mesh);
+  std::cout << "Loading triangle mesh" << std::endl;
+  for (const PlyElement &element : header.elements) {
+    if (element.name == "vertex")
+      std::cout << "\tVertices = " << element.count << std::endl;
+    else if (element.name == "face")
+      std::cout << "\tFaces = " << element.count << std::endl;
+  }
 
-  mesh->faces_.resize(static_cast<size_t>(faces) * 3);
-  ReadPlyFaces(&fin, mesh);
+  mesh->Clear();
+  if (!ReadPlyData(header, file.data() + header.data_offset,
+                   file.data() + file.size(), mesh, &error)) {
+    std::cerr << filename << ": " << error << std::endl;
+    mesh->Clear();
+    return false;
+  }
 
-  fin.close();
+  file.Close();
 
-  ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
+  // Normals stored in the file are used as they are.
+  if (mesh->normals_.empty()) {
+    std::unique_ptr<ThreadPool> pool;
+    if (mesh->faces_.size() / 3 >= kParallelNormalsFaces)
+      pool.reset(new ThreadPool(0));
+    ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_,
+                         weighting, pool.get());
+  }
   ComputeBoundingBox(mesh->vertices_, mesh);
 
   return true;
 }
 
 bool WriteToPly(const std::string &filename, const TriangleMesh &mesh) {
-  (void)filename;
-  (void)mesh;
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  const size_t kFaces = mesh.faces_.size() / 3;
+  const bool kNormals = mesh.normals_.size() == kVertices * 3;
+  const bool kColors = mesh.colors_.size() == kVertices * 3;
+  const bool kTexcoords = mesh.texcoords_.size() == kVertices * 2;
 
-  std::cerr << "Not yet implemented" << std::endl;
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    std::cerr << filename << ": cannot open for writing" << std::endl;
+    return false;
+  }
 
-  // TODO(students): Implement storing to PLY format.
+  // Data is written in the byte order of the host.
+  std::ostringstream header;
+  header << "ply\n"
+         << "format "
+         << (HostIsBigEndian() ? "binary_big_endian" : "binary_little_endian")
+         << " 1.0\n"
+         << "element vertex " << kVertices << "\n"
+         << "property float x\nproperty float y\nproperty float z\n";
+  if (kNormals)
+    header << "property float nx\nproperty float ny\nproperty float nz\n";
+  if (kColors)
+    header << "property uchar red\nproperty uchar green\n"
+              "property uchar blue\n";
+  if (kTexcoords)
+    header << "property float texture_u\nproperty float texture_v\n";
+  header << "element face " << kFaces << "\n"
+         << "property list uchar int vertex_indices\n"
+         << "end_header\n";
+  const std::string kHeader = header.str();
 
-  // END.
+  BlockWriter out(file);
+  out.Write(kHeader.data(), kHeader.size());
 
-  return false;
+  if (!kNormals && !kColors && !kTexcoords) {
+    out.Write(mesh.vertices_.data(), kVertices * 3 * sizeof(float));
+  } else {
+    for (size_t i = 0; i < kVertices; ++i) {
+      for (size_t j = 0; j < 3; ++j) out.Put(mesh.vertices_[i * 3 + j]);
+      if (kNormals)
+        for (size_t j = 0; j < 3; ++j) out.Put(mesh.normals_[i * 3 + j]);
+      if (kColors)
+        for (size_t j = 0; j < 3; ++j) out.Put(ToByte(mesh.colors_[i * 3 + j]));
+      if (kTexcoords)
+        for (size_t j = 0; j < 2; ++j) out.Put(mesh.texcoords_[i * 2 + j]);
+    }
+  }
+
+  for (size_t i = 0; i < kFaces; ++i) {
+    out.Put(static_cast<unsigned char>(3));
+    for (size_t j = 0; j < 3; ++j) out.Put(mesh.faces_[i * 3 + j]);
+  }
+
+  const bool kWritten = out.Flush();
+  if (fclose(file) != 0 || !kWritten) {
+    std::cerr << filename << ": write failed" << std::endl;
+    return false;
+  }
+
+  return true;
 }
 
 }  // namespace data_representation
@@ -6,21 +6,64 @@
 #include <triangle_mesh.h>
 
 #include <string>
+#include <vector>
+
+class ThreadPool;
 
 namespace data_representation {
 
+/**
+ * @brief The NormalWeighting enum How the normals of the faces around a
+ * vertex are blended into its normal: by the angle of each face at the
+ * vertex, or by the area of each face, which needs no acos.
+ */
+enum class NormalWeighting { kAngle, kArea };
+
+/**
+ * @brief ComputeVertexNormals Computes a unit normal per vertex, blending the
+ * normals of the faces around it. A face-parallel pass computes the face
+ * normals (and corner angles), then a vertex-parallel pass gathers them
+ * through a vertex to corner adjacency, with no atomics.
+ * @param vertices The xyz coordinates of the vertices.
+ * @param faces The vertex indices of the triangles.
+ * @param normals The resulting normals, xyz per vertex; zero for vertices
+ * without faces around them.
+ * @param weighting How the face normals are blended.
+ * @param pool Threads for both passes, or null to run them on the calling
+ * thread.
+ */
+void ComputeVertexNormals(const std::vector<float> &vertices,
+                          const std::vector<int> &faces,
+                          std::vector<float> *normals,
+                          NormalWeighting weighting = NormalWeighting::kAngle,
+                          ThreadPool *pool = nullptr);
+
 /**
  * @brief ReadFromPly Read the mesh stored in PLY format at the path filename
- * and stores the corresponding TriangleMesh representation
+ * and stores the corresponding TriangleMesh representation. Reads ascii and
+ * binary files of either byte order with properties of any type; polygons
+ * are split into triangles, and normals, colors and texture coordinates are
+ * loaded when the vertices have them.
  * @param filename The path to the PLY mesh.
- * @param mesh The resulting representation with computed per-vertex normals.
+ * @param mesh The resulting representation with per-vertex normals, computed
+ * if the file has none, on all cores for large meshes.
+ * @param weighting How computed normals blend the faces around a vertex.
  * @return Whether it was able to read the file.
  */
-bool ReadFromPly(const std::string &filename, TriangleMesh *mesh);
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 NormalWeighting weighting = NormalWeighting::kAngle);
+
+/**
+ * @brief HostIsBigEndian Whether the host stores the most significant byte
+ * first: its binary PLY format is binary_big_endian, else
+ * binary_little_endian.
+ */
+bool HostIsBigEndian();
 
 /**
- * @brief WriteToPly Stores the mesh representation in PLY format at the path
- * filename.
+ * @brief WriteToPly Stores the mesh representation in binary PLY format, in
+ * the byte order of the host, at the path filename. Normals, colors and
+ * texture coordinates are stored when the mesh has one per vertex.
  * @param filename The path where the mesh will be stored.
  * @param mesh The mesh to be stored.
  * @return Whether it was able to store the file.
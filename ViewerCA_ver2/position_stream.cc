@@ -0,0 +1,103 @@
+#include "./position_stream.h"
+
+namespace data_visualization {
+
+namespace {
+
+const GLbitfield kPersistentFlags =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+const GLuint64 kFenceTimeout = 1000000000;  // 1 second, in nanoseconds
+
+}  // namespace
+
+PositionStream::PositionStream()
+    : buffer_(0), mapped_(nullptr), segment_floats_(0), count_(0), segment_(0) {
+  for (int i = 0; i < kNumSegments; ++i) fences_[i] = nullptr;
+}
+
+PositionStream::~PositionStream() {}
+
+void PositionStream::Release() {
+  for (int i = 0; i < kNumSegments; ++i) {
+    if (fences_[i] != nullptr) glDeleteSync(fences_[i]);
+    fences_[i] = nullptr;
+  }
+
+  if (buffer_ != 0) {
+    if (mapped_ != nullptr) {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buffer_);
+  }
+
+  buffer_ = 0;
+  mapped_ = nullptr;
+  segment_floats_ = 0;
+  segment_ = 0;
+}
+
+void PositionStream::Reserve(size_t count) {
+  if (buffer_ != 0 && count <= segment_floats_) return;
+
+  // Grow geometrically so a slowly increasing particle count does not
+  // reallocate every frame.
+  size_t floats = segment_floats_ * 2;
+  if (floats < count) floats = count;
+  if (floats < 3 * 1024) floats = 3 * 1024;
+
+  Release();
+  segment_floats_ = floats;
+  GLsizeiptr bytes = kNumSegments * segment_floats_ * sizeof(float);
+
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+  if (GLEW_ARB_buffer_storage) {
+    glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, kPersistentFlags);
+    mapped_ = static_cast<float *>(
+        glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, kPersistentFlags));
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  if (mapped_ == nullptr) staging_.resize(segment_floats_);
+}
+
+float *PositionStream::BeginWrite(size_t count) {
+  Reserve(count);
+  count_ = count;
+
+  GLsync &fence = fences_[segment_];
+  if (fence != nullptr) {
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeout);
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  if (mapped_ != nullptr) return mapped_ + segment_ * segment_floats_;
+  return staging_.data();
+}
+
+GLintptr PositionStream::EndWrite() {
+  GLintptr offset = segment_ * segment_floats_ * sizeof(float);
+
+  if (mapped_ == nullptr) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, count_ * sizeof(float),
+                    staging_.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  return offset;
+}
+
+void PositionStream::Fence() {
+  if (buffer_ == 0) return;
+  fences_[segment_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  segment_ = (segment_ + 1) % kNumSegments;
+}
+
+}  // namespace data_visualization
@@ -0,0 +1,69 @@
+#ifndef POSITION_STREAM_H_
+#define POSITION_STREAM_H_
+
+#include <GL/glew.h>
+
+#include <vector>
+
+namespace data_visualization {
+
+/**
+ * @brief The PositionStream class Streams per-frame particle positions to a
+ * vertex buffer. The buffer is split in kNumSegments segments that are used
+ * as a ring: the CPU fills segment k while the GPU may still be reading
+ * segment k - 1, and a fence per segment keeps the CPU from overwriting data
+ * that is still in flight.
+ *
+ * With GL_ARB_buffer_storage the buffer is mapped once (persistent, coherent)
+ * and the simulation writes straight into it. Otherwise it falls back to a
+ * staging copy plus glBufferSubData into the segment.
+ */
+class PositionStream {
+ public:
+  static const int kNumSegments = 3;
+
+  PositionStream();
+  ~PositionStream();
+
+  /**
+   * @brief BeginWrite Returns a pointer where the next frame's data (count
+   * floats) must be written. Grows the buffer if needed and waits for the GPU
+   * to release the segment. Needs a current GL context.
+   */
+  float *BeginWrite(size_t count);
+
+  /**
+   * @brief EndWrite Publishes the data written since BeginWrite.
+   * @return Byte offset of the written segment inside buffer().
+   */
+  GLintptr EndWrite();
+
+  /**
+   * @brief Fence Marks the segment returned by the last EndWrite as in use by
+   * the draw calls issued so far. Call it right after drawing.
+   */
+  void Fence();
+
+  /**
+   * @brief Release Deletes the GL objects. Needs a current GL context.
+   */
+  void Release();
+
+  GLuint buffer() const { return buffer_; }
+  bool persistent() const { return mapped_ != nullptr; }
+
+ private:
+  void Reserve(size_t count);
+
+  GLuint buffer_;
+  float *mapped_;
+  size_t segment_floats_;
+  size_t count_;
+  int segment_;
+  GLsync fences_[kNumSegments];
+  std::vector<float> staging_;
+};
+
+}  // namespace data_visualization
+
+#endif  // POSITION_STREAM_H_
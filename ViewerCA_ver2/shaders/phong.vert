@@ -2,6 +2,7 @@
 
 layout (location = 0) in vec3 vert;
 layout (location = 1) in vec3 normal;
+layout (location = 2) in vec3 instance_offset; // particle position, divisor 1
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -18,7 +19,7 @@ void main(void)  {
     int i = gl_InstanceID / num_instances;
     int j = gl_InstanceID % num_instances;
     //vec3 posOffset = vec3( offset*i, 0.0f, offset*j );
-    vec3 posOffset = offset;
+    vec3 posOffset = offset + instance_offset;
     vec4 view_vertex = view * model * vec4(vert + posOffset, 1);
     eye_vertex = view_vertex.xyz;
     eye_normal = normalize(normal_matrix * normal);
@@ -14,6 +14,8 @@ namespace data_representation
       vertices_.clear();
       faces_.clear();
       normals_.clear();
+      colors_.clear();
+      texcoords_.clear();
 
       min_ = Eigen::Vector3f(std::numeric_limits<float>::max(),
                              std::numeric_limits<float>::max(),
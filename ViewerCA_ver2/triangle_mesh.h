@@ -31,6 +31,17 @@ class TriangleMesh {
   std::vector<int> faces_;
   std::vector<float> normals_;
 
+  /**
+   * @brief colors_ Per-vertex RGB in [0, 1], empty if the mesh has none.
+   */
+  std::vector<float> colors_;
+
+  /**
+   * @brief texcoords_ Per-vertex texture coordinates (u, v), empty if the
+   * mesh has none.
+   */
+  std::vector<float> texcoords_;
+
   /**
    * @brief min The minimum point of the bounding box.
    */